@@ -9,5 +9,20 @@ enum BytecodeOp {
     BC_JMP, BC_JE, BC_JNE, BC_JG, BC_JL, BC_JLE, BC_JGE,
     BC_LOAD, BC_STORE,
     BC_PUSH, BC_POP,
-    BC_CALL, BC_RET
+    BC_CALL, BC_RET,
+    BC_PUSHM, BC_POPM, BC_ENTER, BC_LEAVE,
+    BC_CMOVE, BC_CMOVNE, BC_CMOVG, BC_CMOVL, BC_CMOVLE, BC_CMOVGE,
+    BC_SETE, BC_SETNE, BC_SETG, BC_SETL, BC_SETLE, BC_SETGE,
+    BC_LOOP,
+    BC_VLOAD, BC_VSTORE, BC_VADD, BC_VSUB, BC_VMUL, BC_VAND, BC_VXOR,
+    BC_VCMPEQ, BC_VCMPGT, BC_VSPLAT, BC_VEXTRACT,
+    BC_ALLOC, BC_FREE,
+    BC_NATIVE,
+    BC_OP_COUNT // number of opcodes, keep last
+};
+
+// Routines behind the reserved "__" symbols, run by BC_NATIVE
+enum Intrinsic {
+    INTRINSIC_MEMCPY, INTRINSIC_SORT, INTRINSIC_HASH32, INTRINSIC_STRLEN,
+    INTRINSIC_COUNT
 };
\ No newline at end of file
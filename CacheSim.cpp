@@ -0,0 +1,209 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#include "CacheSim.hpp"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+CacheSim::CacheSim(const std::vector<CacheLevelConfig>& levels, const std::vector<Symbol>& symbols,
+    const std::vector<std::string>& names, size_t imageSize) {
+    if (levels.empty()) {
+        throw std::runtime_error("Cache model needs at least one level");
+    }
+
+    for (const auto& cfg : levels) {
+        if (cfg.lineSize == 0 || (cfg.lineSize & (cfg.lineSize - 1)) != 0) {
+            throw std::runtime_error("Cache line size must be a power of two: " + cfg.name);
+        }
+        if (cfg.associativity == 0 || cfg.size % (cfg.lineSize * cfg.associativity) != 0) {
+            throw std::runtime_error("Cache size must be a multiple of line size * associativity: " + cfg.name);
+        }
+
+        Level level;
+        level.config = cfg;
+        level.sets = cfg.size / (cfg.lineSize * cfg.associativity);
+        level.lineShift = 0;
+        while ((1u << level.lineShift) < cfg.lineSize) level.lineShift++;
+        level.tags.assign(static_cast<size_t>(level.sets) * cfg.associativity, 0);
+        level.ages.assign(level.tags.size(), 0);
+        levels_.push_back(std::move(level));
+    }
+
+    total_.hits.assign(levels_.size(), 0);
+    total_.misses.assign(levels_.size(), 0);
+
+    // Each data label owns the bytes up to the next data label, the last one up to the end of the image
+    for (const auto& sym : symbols) {
+        if (sym.isExternal) continue;
+        if (sym.isData) {
+            regions_.push_back({ sym.address, 0, names[sym.nameId] });
+        }
+        else {
+            code_.emplace_back(sym.address, names[sym.nameId]);
+        }
+    }
+    std::sort(regions_.begin(), regions_.end(), [](const Region& a, const Region& b) {
+        return a.start < b.start;
+        });
+    for (size_t i = 0; i < regions_.size(); i++) {
+        regions_[i].end = (i + 1 < regions_.size()) ? regions_[i + 1].start : static_cast<int64_t>(imageSize);
+    }
+    std::sort(code_.begin(), code_.end());
+}
+
+std::vector<CacheLevelConfig> CacheSim::defaultLevels() {
+    return {
+        { "L1", 32 * 1024, 64, 8 },
+        { "L2", 256 * 1024, 64, 8 }
+    };
+}
+
+void CacheSim::accessMemory(int32_t ip, int64_t addr, uint32_t size, bool isWrite) {
+    access(ip, addr, size, isWrite);
+}
+
+void CacheSim::accessStack(int32_t ip, int64_t addr, uint32_t size, bool isWrite) {
+    access(ip, STACK_BASE + addr, size, isWrite);
+}
+
+void CacheSim::access(int32_t ip, int64_t addr, uint32_t size, bool isWrite) {
+    Stats& ins = statsFor(perInstruction_, ip);
+    Stats& reg = statsFor(perRegion_, regionOf(addr));
+    Stats* all[] = { &total_, &ins, &reg };
+
+    for (Stats* s : all) {
+        if (isWrite) s->writes++; else s->reads++;
+    }
+
+    // Walk every L1 line the access touches, an unaligned word may straddle two
+    uint32_t shift = levels_[0].lineShift;
+    int64_t firstLine = addr >> shift;
+    int64_t lastLine = (addr + size - 1) >> shift;
+    for (int64_t line = firstLine; line <= lastLine; line++) {
+        int64_t lineAddr = line << shift;
+        for (size_t l = 0; l < levels_.size(); l++) {
+            bool hit = probe(levels_[l], lineAddr);
+            for (Stats* s : all) {
+                if (hit) s->hits[l]++; else s->misses[l]++;
+            }
+            if (hit) break;
+        }
+    }
+}
+
+bool CacheSim::probe(Level& level, int64_t addr) {
+    uint64_t line = static_cast<uint64_t>(addr) >> level.lineShift;
+    uint64_t tag = line + 1;
+    size_t ways = level.config.associativity;
+    size_t base = static_cast<size_t>(line % level.sets) * ways;
+    tick_++;
+
+    size_t victim = base;
+    for (size_t w = base; w < base + ways; w++) {
+        if (level.tags[w] == tag) {
+            level.ages[w] = tick_;
+            return true;
+        }
+        if (level.ages[w] < level.ages[victim]) {
+            victim = w;
+        }
+    }
+
+    // Miss, fill the least recently used way (empty ways have age 0)
+    level.tags[victim] = tag;
+    level.ages[victim] = tick_;
+    return false;
+}
+
+int32_t CacheSim::regionOf(int64_t addr) const {
+    if (addr >= STACK_BASE) {
+        return REGION_STACK;
+    }
+    auto it = std::upper_bound(regions_.begin(), regions_.end(), addr, [](int64_t a, const Region& r) {
+        return a < r.start;
+        });
+    if (it != regions_.begin()) {
+        const Region& r = *std::prev(it);
+        if (addr < r.end) {
+            return static_cast<int32_t>(std::distance(regions_.begin(), it) - 1);
+        }
+    }
+    return REGION_HEAP;
+}
+
+CacheSim::Stats& CacheSim::statsFor(std::unordered_map<int32_t, Stats>& table, int32_t key) {
+    auto it = table.find(key);
+    if (it != table.end()) {
+        return it->second;
+    }
+    Stats& s = table[key];
+    s.hits.assign(levels_.size(), 0);
+    s.misses.assign(levels_.size(), 0);
+    return s;
+}
+
+std::string CacheSim::describeIp(int32_t ip) const {
+    std::ostringstream out;
+    out << "0x" << std::hex << std::setw(4) << std::setfill('0') << ip;
+    auto it = std::upper_bound(code_.begin(), code_.end(), std::make_pair(ip, std::string()),
+        [](const std::pair<int32_t, std::string>& a, const std::pair<int32_t, std::string>& b) {
+            return a.first < b.first;
+        });
+    if (it != code_.begin()) {
+        --it;
+        out << " " << it->second << "+" << std::dec << (ip - it->first);
+    }
+    return out.str();
+}
+
+void CacheSim::printStats(const std::string& name, const Stats& s) const {
+    std::cout << "  " << std::left << std::setw(28) << name << std::right
+        << std::setw(10) << s.reads << std::setw(10) << s.writes;
+    for (size_t l = 0; l < levels_.size(); l++) {
+        uint64_t total = s.hits[l] + s.misses[l];
+        double rate = total ? 100.0 * static_cast<double>(s.hits[l]) / static_cast<double>(total) : 0.0;
+        std::cout << std::setw(10) << s.misses[l] << std::setw(8) << std::fixed << std::setprecision(1) << rate << "%";
+    }
+    std::cout << "\n";
+}
+
+void CacheSim::printReport() const {
+    std::cout << "\n--- Cache Simulation ---\n";
+    for (const auto& level : levels_) {
+        std::cout << level.config.name << ": " << level.config.size << " bytes, "
+            << level.config.lineSize << " byte lines, " << level.config.associativity << "-way, "
+            << level.sets << " sets\n";
+    }
+
+    std::cout << "  " << std::left << std::setw(28) << "" << std::right << std::setw(10) << "reads" << std::setw(10) << "writes";
+    for (const auto& level : levels_) {
+        std::cout << std::setw(10) << (level.config.name + " miss") << std::setw(9) << "hit";
+    }
+    std::cout << "\n";
+
+    printStats("total", total_);
+
+    std::cout << "Per data label:\n";
+    std::vector<std::pair<int32_t, const Stats*>> regions;
+    for (const auto& [region, stats] : perRegion_) regions.emplace_back(region, &stats);
+    std::sort(regions.begin(), regions.end());
+    for (const auto& [region, stats] : regions) {
+        std::string name = region == REGION_STACK ? "[stack]" :
+            region == REGION_HEAP ? "[heap]" : regions_[region].name;
+        printStats(name, *stats);
+    }
+
+    std::cout << "Per instruction (by " << levels_[0].config.name << " misses):\n";
+    std::vector<std::pair<int32_t, const Stats*>> ins;
+    for (const auto& [ip, stats] : perInstruction_) ins.emplace_back(ip, &stats);
+    std::sort(ins.begin(), ins.end(), [](const auto& a, const auto& b) {
+        if (a.second->misses[0] != b.second->misses[0]) return a.second->misses[0] > b.second->misses[0];
+        return a.first < b.first;
+        });
+    for (const auto& [ip, stats] : ins) {
+        printStats(describeIp(ip), *stats);
+    }
+    std::cout << std::defaultfloat << "--- End of Cache Simulation ---\n\n";
+}
@@ -0,0 +1,77 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#pragma once
+
+#include "ObjectFile.hpp"
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+struct CacheLevelConfig {
+    std::string name;
+    uint32_t size;          // bytes
+    uint32_t lineSize;      // bytes, power of two
+    uint32_t associativity; // ways per set
+};
+
+// Set-associative, LRU, multi-level cache model fed by the VM with every guest
+// memory and stack access. Reports hit/miss rates per instruction and per data label.
+class CacheSim {
+public:
+    // names is the table the symbols' nameId indexes, see Linker::getSymbolNames()
+    CacheSim(const std::vector<CacheLevelConfig>& levels, const std::vector<Symbol>& symbols,
+        const std::vector<std::string>& names, size_t imageSize);
+
+    // Typical desktop core: 32KB 8-way L1D, 256KB 8-way L2, 64 byte lines
+    static std::vector<CacheLevelConfig> defaultLevels();
+
+    void accessMemory(int32_t ip, int64_t addr, uint32_t size, bool isWrite);
+    void accessStack(int32_t ip, int64_t addr, uint32_t size, bool isWrite);
+
+    void printReport() const;
+
+private:
+    struct Level {
+        CacheLevelConfig config;
+        uint32_t sets;
+        uint32_t lineShift;
+        std::vector<uint64_t> tags;  // sets * associativity, 0 = empty, else tag + 1
+        std::vector<uint64_t> ages;  // last use tick, for LRU
+    };
+
+    struct Stats {
+        std::vector<uint64_t> hits;
+        std::vector<uint64_t> misses;
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+    };
+
+    struct Region {
+        int64_t start;
+        int64_t end;
+        std::string name;
+    };
+
+    void access(int32_t ip, int64_t addr, uint32_t size, bool isWrite);
+    bool probe(Level& level, int64_t addr);
+    int32_t regionOf(int64_t addr) const;
+    Stats& statsFor(std::unordered_map<int32_t, Stats>& table, int32_t key);
+    std::string describeIp(int32_t ip) const;
+    void printStats(const std::string& name, const Stats& s) const;
+
+    std::vector<Level> levels_;
+    uint64_t tick_ = 0;
+
+    Stats total_;
+    std::unordered_map<int32_t, Stats> perInstruction_;
+    std::unordered_map<int32_t, Stats> perRegion_;
+
+    std::vector<Region> regions_;                     // data labels, sorted by start
+    std::vector<std::pair<int32_t, std::string>> code_; // code labels, sorted by address
+
+    // Stack lives in its own buffer, model it far above guest memory so the two never alias
+    static constexpr int64_t STACK_BASE = int64_t(1) << 40;
+    static constexpr int32_t REGION_STACK = -1;
+    static constexpr int32_t REGION_HEAP = -2;
+};
@@ -5,6 +5,7 @@
 #include <stdexcept>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 
 std::string Compiler::instructionTypeName(InstructionType it) const {
     switch (it) {
@@ -33,6 +34,36 @@ std::string Compiler::instructionTypeName(InstructionType it) const {
     case InstructionType::POP:     return "POP";
     case InstructionType::CALL:    return "CALL";
     case InstructionType::RET:     return "RET";
+    case InstructionType::PUSHM:   return "PUSHM";
+    case InstructionType::POPM:    return "POPM";
+    case InstructionType::ENTER:   return "ENTER";
+    case InstructionType::LEAVE:   return "LEAVE";
+    case InstructionType::CMOVE:   return "CMOVE";
+    case InstructionType::CMOVNE:  return "CMOVNE";
+    case InstructionType::CMOVG:   return "CMOVG";
+    case InstructionType::CMOVL:   return "CMOVL";
+    case InstructionType::CMOVLE:  return "CMOVLE";
+    case InstructionType::CMOVGE:  return "CMOVGE";
+    case InstructionType::SETE:    return "SETE";
+    case InstructionType::SETNE:   return "SETNE";
+    case InstructionType::SETG:    return "SETG";
+    case InstructionType::SETL:    return "SETL";
+    case InstructionType::SETLE:   return "SETLE";
+    case InstructionType::SETGE:   return "SETGE";
+    case InstructionType::LOOP:    return "LOOP";
+    case InstructionType::VLOAD:   return "VLOAD";
+    case InstructionType::VSTORE:  return "VSTORE";
+    case InstructionType::VADD:    return "VADD";
+    case InstructionType::VSUB:    return "VSUB";
+    case InstructionType::VMUL:    return "VMUL";
+    case InstructionType::VAND:    return "VAND";
+    case InstructionType::VXOR:    return "VXOR";
+    case InstructionType::VCMPEQ:  return "VCMPEQ";
+    case InstructionType::VCMPGT:  return "VCMPGT";
+    case InstructionType::VSPLAT:  return "VSPLAT";
+    case InstructionType::VEXTRACT:return "VEXTRACT";
+    case InstructionType::ALLOC:   return "ALLOC";
+    case InstructionType::FREE:    return "FREE";
     default:                        return "UNKNOWN";
     }
 }
@@ -63,6 +94,36 @@ BytecodeOp Compiler::instrToBCOp(InstructionType it) {
     case InstructionType::POP: return BC_POP;
     case InstructionType::CALL:return BC_CALL;
     case InstructionType::RET: return BC_RET;
+    case InstructionType::PUSHM:return BC_PUSHM;
+    case InstructionType::POPM:return BC_POPM;
+    case InstructionType::ENTER:return BC_ENTER;
+    case InstructionType::LEAVE:return BC_LEAVE;
+    case InstructionType::CMOVE:return BC_CMOVE;
+    case InstructionType::CMOVNE:return BC_CMOVNE;
+    case InstructionType::CMOVG:return BC_CMOVG;
+    case InstructionType::CMOVL:return BC_CMOVL;
+    case InstructionType::CMOVLE:return BC_CMOVLE;
+    case InstructionType::CMOVGE:return BC_CMOVGE;
+    case InstructionType::SETE:return BC_SETE;
+    case InstructionType::SETNE:return BC_SETNE;
+    case InstructionType::SETG:return BC_SETG;
+    case InstructionType::SETL:return BC_SETL;
+    case InstructionType::SETLE:return BC_SETLE;
+    case InstructionType::SETGE:return BC_SETGE;
+    case InstructionType::LOOP:return BC_LOOP;
+    case InstructionType::VLOAD:return BC_VLOAD;
+    case InstructionType::VSTORE:return BC_VSTORE;
+    case InstructionType::VADD:return BC_VADD;
+    case InstructionType::VSUB:return BC_VSUB;
+    case InstructionType::VMUL:return BC_VMUL;
+    case InstructionType::VAND:return BC_VAND;
+    case InstructionType::VXOR:return BC_VXOR;
+    case InstructionType::VCMPEQ:return BC_VCMPEQ;
+    case InstructionType::VCMPGT:return BC_VCMPGT;
+    case InstructionType::VSPLAT:return BC_VSPLAT;
+    case InstructionType::VEXTRACT:return BC_VEXTRACT;
+    case InstructionType::ALLOC:return BC_ALLOC;
+    case InstructionType::FREE:return BC_FREE;
     default:
         throw std::runtime_error("Invalid instruction type in compiler");
     }
@@ -91,7 +152,37 @@ void Compiler::emitInt32(std::vector<uint8_t>& segment, int32_t value) {
 }
 
 void Compiler::emitOperand(ObjectFile& obj, const Operand& op, std::vector<Fixup>& fixups) {
-    if (op.isLabel) {
+    bool indexed = op.isMemory && (op.indexReg != -1 ||
+        (op.isRegister && (op.isLabel || op.immediate != 0)) ||
+        (op.isLabel && op.immediate != 0));
+
+    if (indexed) {
+        // Type 5: mem(base + index*scale + disp), followed by base, index and scale bytes.
+        // A label goes into the displacement, the constant part is the fixup addend.
+        uint8_t type = 5;
+        emitByte(obj.codeSegment, type);
+        int32_t dispOffset = static_cast<int32_t>(obj.codeSegment.size());
+        emitInt32(obj.codeSegment, static_cast<int32_t>(op.immediate));
+        emitByte(obj.codeSegment, op.isRegister ? static_cast<uint8_t>(op.regIndex) : 0xFF);
+        emitByte(obj.codeSegment, op.indexReg != -1 ? static_cast<uint8_t>(op.indexReg) : 0xFF);
+        emitByte(obj.codeSegment, static_cast<uint8_t>(op.scale));
+
+        if (op.isLabel) {
+            Fixup fix;
+            fix.bytecodeOffset = dispOffset;
+            fix.symbolId = op.labelId;
+            fix.isDataLabel = false;    // settled in finishObject(), the label may not be defined yet
+            fix.isMemoryReference = true;
+            fixups.push_back(fix);
+        }
+
+        if (debug_) {
+            std::cout << "[Compiler Debug] Emitted indexed memory operand "
+                << (op.isLabel ? labelName(op.labelId) : std::string()) << " base R" << op.regIndex
+                << " index R" << op.indexReg << "*" << op.scale << " disp " << op.immediate << "\n";
+        }
+    }
+    else if (op.isLabel) {
         // Type 4: Label Address (to be fixed up)
         uint8_t type = 4;
         emitByte(obj.codeSegment, type);
@@ -101,14 +192,14 @@ void Compiler::emitOperand(ObjectFile& obj, const Operand& op, std::vector<Fixup
 
         Fixup fix;
         fix.bytecodeOffset = bytecodeOffset;
-        fix.symbolName = op.labelName;
-        fix.isDataLabel = (dataLabels_.find(op.labelName) != dataLabels_.end());
+        fix.symbolId = op.labelId;
+        fix.isDataLabel = false;    // settled in finishObject(), the label may not be defined yet
         fix.isMemoryReference = op.isMemory;
         fixups.push_back(fix);
 
         if (debug_) {
             std::cout << "[Compiler Debug] Recorded fixup for label '"
-                << op.labelName << "' at bytecode offset "
+                << labelName(op.labelId) << "' at bytecode offset "
                 << bytecodeOffset << "\n";
         }
     }
@@ -134,6 +225,16 @@ void Compiler::emitOperand(ObjectFile& obj, const Operand& op, std::vector<Fixup
             }
         }
     }
+    else if (op.isVector) {
+        // Type 6: Vector register
+        uint8_t type = 6;
+        emitByte(obj.codeSegment, type);
+        emitInt32(obj.codeSegment, op.regIndex);
+        if (debug_) {
+            std::cout << "[Compiler Debug] Emitted vector register operand V"
+                << op.regIndex << "\n";
+        }
+    }
     else if (op.isRegister) {
         // Type 1: Register
         uint8_t type = 1;
@@ -144,6 +245,19 @@ void Compiler::emitOperand(ObjectFile& obj, const Operand& op, std::vector<Fixup
                 << op.regIndex << "\n";
         }
     }
+    else if (bits_ == 64 && (op.immediate < INT32_MIN || op.immediate > INT32_MAX)) {
+        // Type 7: 64-bit immediate, low word then high word. In 32-bit mode
+        // the Parser has already limited immediates to 32 bits.
+        uint8_t type = 7;
+        emitByte(obj.codeSegment, type);
+        uint64_t value = static_cast<uint64_t>(op.immediate);
+        emitInt32(obj.codeSegment, static_cast<int32_t>(value & 0xFFFFFFFF));
+        emitInt32(obj.codeSegment, static_cast<int32_t>(value >> 32));
+        if (debug_) {
+            std::cout << "[Compiler Debug] Emitted 64-bit immediate operand "
+                << op.immediate << "\n";
+        }
+    }
     else {
         // Type 0: Immediate
         uint8_t type = 0;
@@ -156,64 +270,149 @@ void Compiler::emitOperand(ObjectFile& obj, const Operand& op, std::vector<Fixup
     }
 }
 
+void Compiler::emitRegisterMask(ObjectFile& obj, const Instruction& ins) {
+    // Register lists collapse into one immediate bitmask operand, bit n = Rn
+    int32_t mask = 0;
+    for (const auto& op : ins.operands) {
+        mask |= op.isRegister ? (1 << op.regIndex) : static_cast<int32_t>(op.immediate);
+    }
+    emitByte(obj.codeSegment, 0);
+    emitInt32(obj.codeSegment, mask);
+    if (debug_) {
+        std::cout << "[Compiler Debug] Emitted register mask 0x"
+            << std::hex << mask << std::dec << "\n";
+    }
+}
+
+// Streaming emits before the Parser's label table is handed over
+std::string Compiler::labelName(int32_t id) const {
+    return id < labels_.size() ? labels_.name(id) : "#" + std::to_string(id);
+}
+
 void Compiler::debugPrint(const std::string& message) const {
     if (debug_) {
         std::cout << "[Compiler Debug] " << message << "\n";
     }
 }
 
-ObjectFile Compiler::compile() {
-    ObjectFile objFile;
-    std::vector<Fixup> fixups;
+const Optimizer& Compiler::getOptimizer() const {
+    return optimizer_;
+}
 
+ObjectFile Compiler::compile() {
     debugPrint("Starting compilation process...");
 
-    for (const auto& ins : instructions_) {
-        if (ins.type == InstructionType::INVALID) {
-            Symbol sym;
-            sym.name = ins.label;
-            sym.address = static_cast<int32_t>(objFile.codeSegment.size());
-            sym.isExternal = false;
-            objFile.symbolTable.push_back(sym);
+    std::vector<Instruction> optimized;
+    if (optimize_) {
+        optimized = optimizer_.optimize(*instructions_, labels_);
+    }
+    const std::vector<Instruction>& instructions = optimize_ ? optimized : *instructions_;
 
-            debugPrint("Defined label '" + ins.label + "' at address " + std::to_string(sym.address));
-            continue;
-        }
+    obj_ = ObjectFile();
+    fixups_.clear();
+    for (const auto& ins : instructions) {
+        emitInstruction(ins);
+    }
 
-        BytecodeOp op = instrToBCOp(ins.type);
-        emitByte(objFile.codeSegment, static_cast<uint8_t>(op));
-        debugPrint("Emitted opcode: " + bcOpName(op) + " for instruction " + instructionTypeName(ins.type));
+    return finishObject(*dataSegment_, *dataLabels_, *dataRelocs_);
+}
 
-        for (const auto& operand : ins.operands) {
-            emitOperand(objFile, operand, fixups);
-        }
+void Compiler::emit(const Instruction& ins, int32_t bits) {
+    // .bits must come before any code, so it is settled by the first instruction
+    bits_ = bits;
+    emitInstruction(ins);
+}
+
+ObjectFile Compiler::finish(const Parser& parser) {
+    bits_ = parser.getBits();
+    labels_ = parser.getLabels();
+    return finishObject(parser.getDataSegment(), parser.getDataLabels(), parser.getDataRelocs());
+}
+
+void Compiler::emitInstruction(const Instruction& ins) {
+    if (ins.type == InstructionType::INVALID) {
+        Symbol sym;
+        sym.nameId = ins.labelId;
+        sym.address = static_cast<int32_t>(obj_.codeSegment.size());
+        sym.isExternal = false;
+        obj_.symbolTable.push_back(sym);
+
+        debugPrint("Defined label '" + labelName(ins.labelId) + "' at address " + std::to_string(sym.address));
+        return;
     }
 
+    BytecodeOp op = instrToBCOp(ins.type);
+    emitByte(obj_.codeSegment, static_cast<uint8_t>(op));
+    debugPrint("Emitted opcode: " + bcOpName(op) + " for instruction " + instructionTypeName(ins.type));
+
+    if (ins.type == InstructionType::PUSHM || ins.type == InstructionType::POPM) {
+        emitRegisterMask(obj_, ins);
+        return;
+    }
+
+    for (const auto& operand : ins.operands) {
+        emitOperand(obj_, operand, fixups_);
+    }
+}
+
+ObjectFile Compiler::finishObject(const std::vector<int32_t>& dataSegment,
+    const std::unordered_map<int32_t, int32_t>& dataLabels,
+    const std::vector<DataReloc>& dataRelocs) {
+    ObjectFile objFile = std::move(obj_);
+    obj_ = ObjectFile();
+    objFile.bits = bits_;
+
     debugPrint("All instructions emitted. Handling data segment...");
 
+    // Code fixups were recorded before every label was known
+    for (auto& fix : fixups_) {
+        fix.isDataLabel = (dataLabels.find(fix.symbolId) != dataLabels.end());
+    }
 
     size_t dataBaseAddress = objFile.codeSegment.size();
     objFile.codeSize = dataBaseAddress;
 
-    for (const auto& [label, offset] : dataLabels_) {
+    // By offset, then label ID, so the object does not depend on hash map order
+    std::vector<std::pair<int32_t, int32_t>> dataSymbols;
+    dataSymbols.reserve(dataLabels.size());
+    for (const auto& [labelId, offset] : dataLabels) {
+        dataSymbols.emplace_back(offset, labelId);
+    }
+    std::sort(dataSymbols.begin(), dataSymbols.end());
+
+    for (const auto& [offset, labelId] : dataSymbols) {
         Symbol sym;
-        sym.name = label;
-        sym.address = static_cast<int32_t>(dataBaseAddress + offset * 4);
+        sym.nameId = labelId;
+        sym.address = static_cast<int32_t>(dataBaseAddress + offset);
         sym.isExternal = false;
         sym.isData = true;
         objFile.symbolTable.push_back(sym);
 
-        debugPrint("Defined data label '" + label + "' at address " + std::to_string(sym.address));
+        debugPrint("Defined data label '" + labels_.name(labelId) + "' at address " + std::to_string(sym.address));
     }
 
-    for (const auto& dataWord : dataSegment_) {
+    for (const auto& dataWord : dataSegment) {
         emitInt32(objFile.dataSegment, dataWord);
     }
 
+    // Fixups past codeSize land in the data segment, the same way data symbol addresses are counted
+    for (const auto& reloc : dataRelocs) {
+        Fixup fix;
+        fix.bytecodeOffset = static_cast<int32_t>(dataBaseAddress + reloc.offset);
+        fix.symbolId = reloc.labelId;
+        fix.isDataLabel = (dataLabels.find(reloc.labelId) != dataLabels.end());
+        fix.isMemoryReference = false;
+        fixups_.push_back(fix);
+
+        debugPrint("Recorded data fixup for label '" + labels_.name(reloc.labelId) + "' at data offset " + std::to_string(reloc.offset));
+    }
+
     debugPrint("Data segment appended. Total bytecode size: " +
         std::to_string(objFile.codeSegment.size() + objFile.dataSegment.size()) + " bytes");
 
-    objFile.fixups = fixups;
+    objFile.fixups = std::move(fixups_);
+    fixups_.clear();
+    objFile.names = labels_.names();
 
     debugPrint("Compilation process completed.");
 
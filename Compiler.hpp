@@ -5,6 +5,7 @@
 #include "ObjectFile.hpp"
 #include "BytecodeOp.hpp"
 #include "Parser.hpp"
+#include "Optimizer.hpp"
 #include <vector>
 #include <unordered_map>
 #include <string>
@@ -13,26 +14,64 @@ class Compiler {
 public:
     Compiler(const std::vector<Instruction>& instructions,
         const std::vector<int32_t>& dataSegment,
-        const std::unordered_map<std::string, int32_t>& dataLabels,
-        bool debug = false)
-        : instructions_(instructions),
-        dataSegment_(dataSegment),
-        dataLabels_(dataLabels),
-        debug_(debug) {
+        const std::unordered_map<int32_t, int32_t>& dataLabels,
+        const std::vector<DataReloc>& dataRelocs,
+        const LabelTable& labels,
+        bool debug = false, bool optimize = false, int32_t bits = 32)
+        : instructions_(&instructions),
+        dataSegment_(&dataSegment),
+        dataLabels_(&dataLabels),
+        dataRelocs_(&dataRelocs),
+        labels_(labels),
+        debug_(debug),
+        optimize_(optimize),
+        bits_(bits),
+        optimizer_(debug) {
+    }
+
+    // Streaming: the Parser hands each instruction to emit() as soon as it is
+    // parsed, and finish() adds the data and symbols once parsing is done. No
+    // instruction list is built, and the optimizer does not run.
+    explicit Compiler(bool debug = false)
+        : debug_(debug),
+        optimize_(false),
+        optimizer_(debug) {
     }
 
     ObjectFile compile();
 
+    void emit(const Instruction& ins, int32_t bits);
+    ObjectFile finish(const Parser& parser);
+
+    const Optimizer& getOptimizer() const;
+
 private:
     void emitByte(std::vector<uint8_t>& segment, uint8_t byte);
     void emitInt32(std::vector<uint8_t>& segment, int32_t value);
     BytecodeOp instrToBCOp(InstructionType it);
+    void emitInstruction(const Instruction& ins);
     void emitOperand(ObjectFile& obj, const Operand& op, std::vector<Fixup>& fixups);
+    void emitRegisterMask(ObjectFile& obj, const Instruction& ins);
+    ObjectFile finishObject(const std::vector<int32_t>& dataSegment,
+        const std::unordered_map<int32_t, int32_t>& dataLabels,
+        const std::vector<DataReloc>& dataRelocs);
+    std::string labelName(int32_t id) const;
     void debugPrint(const std::string& message) const;
     std::string instructionTypeName(InstructionType it) const;
 
-    const std::vector<Instruction>& instructions_;
-    const std::vector<int32_t>& dataSegment_;
-    const std::unordered_map<std::string, int32_t>& dataLabels_;
+    // Parser output, buffered mode only
+    const std::vector<Instruction>* instructions_ = nullptr;
+    const std::vector<int32_t>* dataSegment_ = nullptr;
+    const std::unordered_map<int32_t, int32_t>* dataLabels_ = nullptr;
+    const std::vector<DataReloc>* dataRelocs_ = nullptr;
+
+    LabelTable labels_;     // own copy, the optimizer adds labels; becomes the object's names table
     bool debug_;
+    bool optimize_;
+    int32_t bits_ = 32;
+    Optimizer optimizer_;
+
+    // The object being emitted
+    ObjectFile obj_;
+    std::vector<Fixup> fixups_;
 };
@@ -0,0 +1,432 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#include "ControlFlow.hpp"
+#include <algorithm>
+
+static RegisterSet registerBit(int32_t reg) {
+    return reg >= 0 && reg < 16 ? RegisterSet(1) << reg : 0;
+}
+
+// Registers read to form a memory operand's address
+static RegisterSet addressRegisters(const Operand& op) {
+    RegisterSet regs = 0;
+    if (op.isRegister && !op.isVector) regs |= registerBit(op.regIndex);
+    if (op.indexReg != -1) regs |= registerBit(op.indexReg);
+    return regs;
+}
+
+static bool isJump(InstructionType t) {
+    switch (t) {
+    case InstructionType::JMP: case InstructionType::JE: case InstructionType::JNE:
+    case InstructionType::JG: case InstructionType::JL: case InstructionType::JLE:
+    case InstructionType::JGE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool isDirectTarget(const Operand& op) {
+    return op.isLabel && !op.isMemory && op.indexReg == -1;
+}
+
+// Writing R15 is a jump; CALL comes back to the next instruction
+static bool writesProgramCounter(const Instruction& ins) {
+    return ins.type != InstructionType::CALL && (instructionEffects(ins).defs & registerBit(15)) != 0;
+}
+
+InstructionEffects instructionEffects(const Instruction& ins) {
+    InstructionEffects effects;
+    bool writesFirst = false;   // operand 0 is a destination
+    bool readsFirst = true;     // operand 0 is also read
+
+    switch (ins.type) {
+    case InstructionType::MOV: case InstructionType::LOAD: case InstructionType::STORE:
+    case InstructionType::ADD: case InstructionType::SUB: case InstructionType::MUL:
+    case InstructionType::DIV: case InstructionType::POP: case InstructionType::VEXTRACT:
+    case InstructionType::VSTORE:
+        writesFirst = true;
+        readsFirst = false;
+        break;
+    case InstructionType::SETE: case InstructionType::SETNE: case InstructionType::SETG:
+    case InstructionType::SETL: case InstructionType::SETLE: case InstructionType::SETGE:
+        writesFirst = true;
+        readsFirst = false;
+        effects.readsFlags = true;
+        break;
+    case InstructionType::AND: case InstructionType::OR: case InstructionType::XOR:
+    case InstructionType::SHL: case InstructionType::SHR:
+        writesFirst = true;
+        break;
+    case InstructionType::CMOVE: case InstructionType::CMOVNE: case InstructionType::CMOVG:
+    case InstructionType::CMOVL: case InstructionType::CMOVLE: case InstructionType::CMOVGE:
+        writesFirst = true;     // and read, the move may not happen
+        effects.readsFlags = true;
+        break;
+    case InstructionType::CMP:
+        effects.writesFlags = true;
+        break;
+    case InstructionType::LOOP:
+        writesFirst = true;
+        effects.writesFlags = true;
+        break;
+    case InstructionType::JE: case InstructionType::JNE: case InstructionType::JG:
+    case InstructionType::JL: case InstructionType::JLE: case InstructionType::JGE:
+        effects.readsFlags = true;
+        break;
+    case InstructionType::JMP: case InstructionType::VLOAD: case InstructionType::VADD:
+    case InstructionType::VSUB: case InstructionType::VMUL: case InstructionType::VAND:
+    case InstructionType::VXOR: case InstructionType::VCMPEQ: case InstructionType::VCMPGT:
+    case InstructionType::VSPLAT:
+        break;
+    case InstructionType::PUSH:
+        effects.uses |= registerBit(14);
+        effects.defs |= registerBit(14);
+        effects.writesMemory = true;
+        break;
+    case InstructionType::PUSHM: case InstructionType::POPM: {
+        RegisterSet mask = 0;
+        for (const auto& op : ins.operands) {
+            mask |= op.isRegister ? registerBit(op.regIndex) : static_cast<RegisterSet>(op.immediate) & ALL_REGISTERS;
+        }
+        effects.uses = registerBit(14);
+        effects.defs = registerBit(14);
+        if (ins.type == InstructionType::PUSHM) {
+            effects.uses |= mask;
+            effects.writesMemory = true;
+        }
+        else {
+            effects.defs |= mask;
+            effects.readsMemory = true;
+        }
+        return effects;
+    }
+    case InstructionType::ENTER:
+        effects.uses |= registerBit(13) | registerBit(14);
+        effects.defs |= registerBit(13) | registerBit(14);
+        effects.writesMemory = true;
+        break;
+    case InstructionType::LEAVE:
+        effects.uses |= registerBit(13);
+        effects.defs |= registerBit(13) | registerBit(14);
+        effects.readsMemory = true;
+        break;
+    case InstructionType::RET:
+        // Results are returned in registers
+        effects.uses = ALL_REGISTERS;
+        effects.defs = registerBit(14) | registerBit(15);
+        effects.readsMemory = true;
+        return effects;
+    case InstructionType::ALLOC: case InstructionType::FREE:
+        // The heap counts as memory
+        writesFirst = ins.type == InstructionType::ALLOC;
+        readsFirst = !writesFirst;
+        effects.readsMemory = true;
+        effects.writesMemory = true;
+        break;
+    case InstructionType::INVALID:
+        return effects;
+    default:
+        // CALL, and anything new: the callee may read and clobber everything
+        effects.uses = ALL_REGISTERS;
+        effects.defs = ALL_REGISTERS;
+        effects.readsMemory = true;
+        effects.writesMemory = true;
+        effects.readsFlags = true;
+        effects.writesFlags = true;
+        return effects;
+    }
+
+    for (size_t i = 0; i < ins.operands.size(); i++) {
+        const Operand& op = ins.operands[i];
+        bool destination = i == 0 && writesFirst;
+        if (op.isMemory) {
+            effects.uses |= addressRegisters(op);
+            if (destination) effects.writesMemory = true;
+            if (!destination || readsFirst) effects.readsMemory = true;
+        }
+        else if (op.isRegister && !op.isVector) {
+            if (destination) effects.defs |= registerBit(op.regIndex);
+            if (!destination || readsFirst) effects.uses |= registerBit(op.regIndex);
+        }
+    }
+    return effects;
+}
+
+ControlFlowGraph::ControlFlowGraph(const std::vector<Instruction>& code, const std::vector<bool>& internalLabels)
+    : code_(code)
+{
+    int32_t labelCount = 0;
+    for (const auto& ins : code_) {
+        labelCount = std::max(labelCount, ins.labelId + 1);
+        for (const auto& op : ins.operands) {
+            labelCount = std::max(labelCount, op.labelId + 1);
+        }
+    }
+    labelBlocks_.assign(labelCount, -1);
+
+    // Labels used as anything but a direct jump or LOOP target
+    std::vector<bool> escapes(labelCount, false);
+    for (const auto& ins : code_) {
+        for (size_t i = 0; i < ins.operands.size(); i++) {
+            const Operand& op = ins.operands[i];
+            if (!op.isLabel) continue;
+            bool jump = (isJump(ins.type) && i == 0) || (ins.type == InstructionType::LOOP && i == 1);
+            if (!jump || !isDirectTarget(op)) escapes[op.labelId] = true;
+        }
+    }
+
+    // Split into blocks
+    size_t start = 0;
+    for (size_t i = 0; i < code_.size(); i++) {
+        const Instruction& ins = code_[i];
+        if (ins.type == InstructionType::INVALID && i > start && code_[i - 1].type != InstructionType::INVALID) {
+            blocks_.push_back({ start, i });
+            start = i;
+        }
+        if (ins.type == InstructionType::INVALID) {
+            labelBlocks_[ins.labelId] = static_cast<int32_t>(blocks_.size());
+            continue;
+        }
+        bool terminates = isJump(ins.type) || ins.type == InstructionType::LOOP || ins.type == InstructionType::RET ||
+            writesProgramCounter(ins);
+        if (terminates) {
+            blocks_.push_back({ start, i + 1 });
+            start = i + 1;
+        }
+    }
+    if (start < code_.size() || blocks_.empty()) {
+        blocks_.push_back({ start, code_.size() });
+    }
+
+    for (size_t b = 0; b < blocks_.size(); b++) {
+        BasicBlock& block = blocks_[b];
+        for (size_t i = block.begin; i < block.end && code_[i].type == InstructionType::INVALID; i++) {
+            int32_t id = code_[i].labelId;
+            bool internal = static_cast<size_t>(id) < internalLabels.size() && internalLabels[id];
+            if (!internal || escapes[id]) block.isEntry = true;
+        }
+    }
+    blocks_[0].isEntry = true;
+
+    for (size_t b = 0; b < blocks_.size(); b++) {
+        BasicBlock& block = blocks_[b];
+        bool fallsThrough = true;
+        if (block.end > block.begin) {
+            const Instruction& last = code_[block.end - 1];
+            bool jump = isJump(last.type) || last.type == InstructionType::LOOP;
+            if (jump) {
+                const Operand& target = last.operands[last.type == InstructionType::LOOP ? 1 : 0];
+                int32_t to = isDirectTarget(target) ? labelBlocks_[target.labelId] : -1;
+                if (to >= 0) addEdge(b, static_cast<size_t>(to));
+                else block.exits = true;
+                fallsThrough = last.type != InstructionType::JMP;
+            }
+            else if (last.type == InstructionType::RET || writesProgramCounter(last)) {
+                block.exits = true;
+                fallsThrough = false;
+            }
+        }
+        if (fallsThrough) {
+            block.fallsThrough = true;
+            if (b + 1 < blocks_.size()) addEdge(b, b + 1);
+            else block.exits = true;
+        }
+    }
+
+    computeDominators();
+}
+
+void ControlFlowGraph::addEdge(size_t from, size_t to) {
+    BasicBlock& block = blocks_[from];
+    if (std::find(block.successors.begin(), block.successors.end(), to) == block.successors.end()) {
+        block.successors.push_back(to);
+        blocks_[to].predecessors.push_back(from);
+    }
+}
+
+const std::vector<BasicBlock>& ControlFlowGraph::getBlocks() const {
+    return blocks_;
+}
+
+int32_t ControlFlowGraph::blockOfLabel(int32_t labelId) const {
+    return labelId >= 0 && labelId < static_cast<int32_t>(labelBlocks_.size()) ? labelBlocks_[labelId] : -1;
+}
+
+void ControlFlowGraph::computeLiveness() {
+    // Registers each block reads before writing them, and writes
+    std::vector<RegisterSet> uses(blocks_.size(), 0);
+    std::vector<RegisterSet> defs(blocks_.size(), 0);
+    for (size_t b = 0; b < blocks_.size(); b++) {
+        for (size_t i = blocks_[b].end; i-- > blocks_[b].begin;) {
+            InstructionEffects effects = instructionEffects(code_[i]);
+            uses[b] = (uses[b] & ~effects.defs) | effects.uses;
+            defs[b] |= effects.defs;
+        }
+        blocks_[b].liveIn = 0;
+        blocks_[b].liveOut = 0;
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t b = blocks_.size(); b-- > 0;) {
+            BasicBlock& block = blocks_[b];
+            RegisterSet out = block.exits ? ALL_REGISTERS : 0;
+            for (size_t s : block.successors) {
+                out |= blocks_[s].liveIn;
+            }
+            RegisterSet in = uses[b] | (out & ~defs[b]);
+            if (in != block.liveIn || out != block.liveOut) {
+                block.liveIn = in;
+                block.liveOut = out;
+                changed = true;
+            }
+        }
+    }
+}
+
+// Cooper, Harvey and Kennedy's iterative algorithm, with a virtual root
+// (index blocks_.size()) above every entry
+void ControlFlowGraph::computeDominators() {
+    size_t root = blocks_.size();
+    order_.assign(blocks_.size() + 1, NONE);
+    idom_.assign(blocks_.size() + 1, NONE);
+
+    // Postorder by an explicit stack of (block, next successor)
+    std::vector<size_t> postorder;
+    std::vector<bool> seen(blocks_.size(), false);
+    std::vector<std::pair<size_t, size_t>> stack;
+    for (size_t e = 0; e < blocks_.size(); e++) {
+        if (!blocks_[e].isEntry || seen[e]) continue;
+        seen[e] = true;
+        stack.push_back({ e, 0 });
+        while (!stack.empty()) {
+            auto& [b, next] = stack.back();
+            if (next < blocks_[b].successors.size()) {
+                size_t s = blocks_[b].successors[next++];
+                if (!seen[s]) {
+                    seen[s] = true;
+                    stack.push_back({ s, 0 });
+                }
+            }
+            else {
+                postorder.push_back(b);
+                stack.pop_back();
+            }
+        }
+    }
+
+    // Reverse postorder numbers, the root first
+    order_[root] = 0;
+    for (size_t k = 0; k < postorder.size(); k++) {
+        order_[postorder[postorder.size() - 1 - k]] = k + 1;
+    }
+    idom_[root] = root;
+
+    auto intersect = [&](size_t a, size_t b) {
+        while (a != b) {
+            while (order_[a] > order_[b]) a = idom_[a];
+            while (order_[b] > order_[a]) b = idom_[b];
+        }
+        return a;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t k = postorder.size(); k-- > 0;) {
+            size_t b = postorder[k];
+            size_t dom = blocks_[b].isEntry ? root : NONE;
+            for (size_t p : blocks_[b].predecessors) {
+                if (idom_[p] == NONE) continue;
+                dom = dom == NONE ? p : intersect(p, dom);
+            }
+            if (dom != idom_[b]) {
+                idom_[b] = dom;
+                changed = true;
+            }
+        }
+    }
+}
+
+bool ControlFlowGraph::dominates(size_t a, size_t b) const {
+    if (order_[a] == NONE || order_[b] == NONE) return false;
+    size_t root = blocks_.size();
+    while (b != a && b != root) {
+        b = idom_[b];
+    }
+    return b == a;
+}
+
+std::vector<Loop> ControlFlowGraph::findLoops() const {
+    std::vector<Loop> loops;
+    std::vector<size_t> loopOfHeader(blocks_.size(), NONE);
+    std::vector<size_t> member(blocks_.size(), NONE);   // loop a block was last added to
+
+    for (size_t t = 0; t < blocks_.size(); t++) {
+        for (size_t h : blocks_[t].successors) {
+            if (!dominates(h, t)) continue;
+
+            if (loopOfHeader[h] == NONE) {
+                loopOfHeader[h] = loops.size();
+                loops.push_back({ h, { h }, {} });
+                member[h] = loopOfHeader[h];
+            }
+            size_t index = loopOfHeader[h];
+            Loop& loop = loops[index];
+            loop.latches.push_back(t);
+
+            // Everything that reaches the latch without passing the header
+            std::vector<size_t> work;
+            if (t != h && member[t] != index) {
+                member[t] = index;
+                loop.blocks.push_back(t);
+                work.push_back(t);
+            }
+            while (!work.empty()) {
+                size_t b = work.back();
+                work.pop_back();
+                for (size_t p : blocks_[b].predecessors) {
+                    if (p != h && member[p] != index && order_[p] != NONE) {
+                        member[p] = index;
+                        loop.blocks.push_back(p);
+                        work.push_back(p);
+                    }
+                }
+            }
+        }
+    }
+
+    // A block can be added twice when another loop claimed it in between
+    for (auto& loop : loops) {
+        std::sort(loop.blocks.begin(), loop.blocks.end());
+        loop.blocks.erase(std::unique(loop.blocks.begin(), loop.blocks.end()), loop.blocks.end());
+    }
+    std::stable_sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b) {
+        return a.blocks.size() < b.blocks.size();
+    });
+    return loops;
+}
+
+std::vector<bool> ControlFlowGraph::reachable() const {
+    std::vector<bool> seen(blocks_.size(), false);
+    std::vector<size_t> work;
+    for (size_t b = 0; b < blocks_.size(); b++) {
+        if (blocks_[b].isEntry) {
+            seen[b] = true;
+            work.push_back(b);
+        }
+    }
+    while (!work.empty()) {
+        size_t b = work.back();
+        work.pop_back();
+        for (size_t s : blocks_[b].successors) {
+            if (!seen[s]) {
+                seen[s] = true;
+                work.push_back(s);
+            }
+        }
+    }
+    return seen;
+}
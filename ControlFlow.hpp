@@ -0,0 +1,91 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#pragma once
+
+#include "Parser.hpp"
+#include <vector>
+#include <cstdint>
+
+// Registers as a bitmask, bit n = Rn
+using RegisterSet = uint32_t;
+constexpr RegisterSet ALL_REGISTERS = 0xFFFF;
+
+// What one instruction reads and writes, as far as the optimizer needs to
+// know. CALL and anything unrecognised use and clobber every register.
+struct InstructionEffects {
+    RegisterSet uses = 0;
+    RegisterSet defs = 0;
+    bool readsMemory = false;
+    bool writesMemory = false;
+    bool readsFlags = false;
+    bool writesFlags = false;
+};
+
+InstructionEffects instructionEffects(const Instruction& ins);
+
+struct BasicBlock {
+    size_t begin;   // first instruction, label definitions included
+    size_t end;     // one past the last
+    std::vector<size_t> successors = {};
+    std::vector<size_t> predecessors = {};
+    bool isEntry = false;   // may be entered from code the graph cannot see
+    bool exits = false;     // may leave to code the graph cannot see
+    bool fallsThrough = false;  // may run on into the next block in the list
+    RegisterSet liveIn = 0;
+    RegisterSet liveOut = 0;
+};
+
+// A natural loop: the header dominates every block in it, and each latch
+// jumps back to the header
+struct Loop {
+    size_t header;
+    std::vector<size_t> blocks;     // ascending, header included
+    std::vector<size_t> latches;
+};
+
+// Basic blocks of an instruction list, split at every label definition and
+// after every jump, LOOP, RET and write to R15.
+//
+// The graph only knows edges inside the list. The first block is an entry, as
+// is every label other code could reach. Every label from the source is a
+// global symbol that another object may jump to or call, so only labels marked
+// in internalLabels (label ID to whether the optimizer made it) that are used
+// as nothing but direct jump or LOOP targets can be internal. RET, jumps to
+// labels defined elsewhere, computed jumps and falling off the end leave the
+// graph, with every register live.
+class ControlFlowGraph {
+public:
+    ControlFlowGraph(const std::vector<Instruction>& code, const std::vector<bool>& internalLabels);
+
+    const std::vector<BasicBlock>& getBlocks() const;
+
+    // Block a label definition starts, -1 for labels not defined in the list
+    int32_t blockOfLabel(int32_t labelId) const;
+
+    // Fills in liveIn and liveOut of every block. Reads the instructions
+    // again, so it can be rerun after they are rewritten in place.
+    void computeLiveness();
+
+    // Blocks reachable from an entry
+    std::vector<bool> reachable() const;
+
+    // Whether every path from an entry to block b passes through block a.
+    // Unreachable blocks are dominated by nothing.
+    bool dominates(size_t a, size_t b) const;
+
+    // Natural loops found from back edges, those sharing a header merged,
+    // innermost (fewest blocks) first
+    std::vector<Loop> findLoops() const;
+
+private:
+    void addEdge(size_t from, size_t to);
+    void computeDominators();
+
+    const std::vector<Instruction>& code_;
+    std::vector<BasicBlock> blocks_;
+    std::vector<int32_t> labelBlocks_;  // label ID to block, -1 if not defined here
+    std::vector<size_t> idom_;          // immediate dominator, blocks_.size() for entries
+    std::vector<size_t> order_;         // reverse postorder number, NONE if unreachable
+
+    static constexpr size_t NONE = static_cast<size_t>(-1);
+};
@@ -0,0 +1,128 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#include "Keywords.hpp"
+#include <iterator>
+
+namespace {
+
+using IT = InstructionType;
+constexpr KeywordKind M = KeywordKind::MNEMONIC;
+constexpr KeywordKind D = KeywordKind::DIRECTIVE;
+
+constexpr Keyword keywords[] = {
+    {"MOV", M, IT::MOV}, {"ADD", M, IT::ADD}, {"SUB", M, IT::SUB}, {"MUL", M, IT::MUL},
+    {"DIV", M, IT::DIV}, {"AND", M, IT::AND}, {"OR", M, IT::OR}, {"XOR", M, IT::XOR},
+    {"SHL", M, IT::SHL}, {"SHR", M, IT::SHR}, {"CMP", M, IT::CMP},
+    {"JMP", M, IT::JMP}, {"JE", M, IT::JE}, {"JNE", M, IT::JNE}, {"JG", M, IT::JG},
+    {"JL", M, IT::JL}, {"JLE", M, IT::JLE}, {"JGE", M, IT::JGE},
+    {"LOAD", M, IT::LOAD}, {"STORE", M, IT::STORE}, {"PUSH", M, IT::PUSH}, {"POP", M, IT::POP},
+    {"CALL", M, IT::CALL}, {"RET", M, IT::RET},
+    {"PUSHM", M, IT::PUSHM}, {"POPM", M, IT::POPM}, {"ENTER", M, IT::ENTER}, {"LEAVE", M, IT::LEAVE},
+    {"CMOVE", M, IT::CMOVE}, {"CMOVNE", M, IT::CMOVNE}, {"CMOVG", M, IT::CMOVG},
+    {"CMOVL", M, IT::CMOVL}, {"CMOVLE", M, IT::CMOVLE}, {"CMOVGE", M, IT::CMOVGE},
+    {"SETE", M, IT::SETE}, {"SETNE", M, IT::SETNE}, {"SETG", M, IT::SETG},
+    {"SETL", M, IT::SETL}, {"SETLE", M, IT::SETLE}, {"SETGE", M, IT::SETGE},
+    {"LOOP", M, IT::LOOP},
+    {"VLOAD", M, IT::VLOAD}, {"VSTORE", M, IT::VSTORE}, {"VADD", M, IT::VADD}, {"VSUB", M, IT::VSUB},
+    {"VMUL", M, IT::VMUL}, {"VAND", M, IT::VAND}, {"VXOR", M, IT::VXOR}, {"VCMPEQ", M, IT::VCMPEQ},
+    {"VCMPGT", M, IT::VCMPGT}, {"VSPLAT", M, IT::VSPLAT}, {"VEXTRACT", M, IT::VEXTRACT},
+    {"ALLOC", M, IT::ALLOC}, {"FREE", M, IT::FREE},
+    {"DATA", D, IT::INVALID}, {"CODE", D, IT::INVALID}, {"WORD", D, IT::INVALID},
+    {"DWORD", D, IT::INVALID}, {"BITS", D, IT::INVALID}, {"JUMPTABLE", D, IT::INVALID},
+    {"INCLUDE", D, IT::INVALID},
+};
+
+constexpr size_t KEYWORD_COUNT = std::size(keywords);
+constexpr size_t MAX_KEYWORD_LENGTH = 9;
+constexpr uint32_t TABLE_BITS = 10;
+constexpr uint32_t TABLE_SIZE = 1u << TABLE_BITS;
+
+// Clearing bit 5 upper-cases letters; digits and '_' move too, but the same
+// way for keywords and source words, and a hit is always confirmed by compare
+constexpr uint32_t hashWord(std::string_view word, uint32_t seed) {
+    uint32_t h = seed ^ static_cast<uint32_t>(word.size());
+    for (char c : word) {
+        h = (h ^ (static_cast<uint8_t>(c) & 0xDFu)) * 16777619u;
+    }
+    return h >> (32 - TABLE_BITS);
+}
+
+struct HashTable {
+    uint32_t seed;
+    uint8_t slots[TABLE_SIZE];  // keyword index + 1, 0 = empty
+};
+
+// Tries seeds until every keyword lands in its own slot. Runs at compile
+// time; about one seed in six works for this table size.
+constexpr HashTable buildTable() {
+    for (uint32_t seed = 1;; seed++) {
+        HashTable table{ seed, {} };
+        bool perfect = true;
+        for (size_t i = 0; i < KEYWORD_COUNT && perfect; i++) {
+            uint32_t slot = hashWord(keywords[i].name, seed);
+            if (table.slots[slot] != 0) {
+                perfect = false;
+            }
+            table.slots[slot] = static_cast<uint8_t>(i + 1);
+        }
+        if (perfect) {
+            return table;
+        }
+    }
+}
+
+constexpr HashTable table = buildTable();
+static_assert(KEYWORD_COUNT < 255, "keyword index must fit a slot byte");
+
+constexpr char upper(char c) {
+    return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+} // namespace
+
+const Keyword* findKeyword(std::string_view word) {
+    if (word.empty() || word.size() > MAX_KEYWORD_LENGTH) {
+        return nullptr;
+    }
+
+    uint8_t slot = table.slots[hashWord(word, table.seed)];
+    if (slot == 0) {
+        return nullptr;
+    }
+
+    const Keyword& keyword = keywords[slot - 1];
+    if (keyword.name.size() != word.size()) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < word.size(); i++) {
+        if (upper(word[i]) != keyword.name[i]) {
+            return nullptr;
+        }
+    }
+    return &keyword;
+}
+
+int32_t registerIndex(std::string_view word, bool& isVector) {
+    isVector = false;
+    if (word.size() < 2 || word.size() > 3) {
+        return -1;
+    }
+
+    char prefix = upper(word[0]);
+    int32_t index = 0;
+    for (size_t i = 1; i < word.size(); i++) {
+        if (word[i] < '0' || word[i] > '9') {
+            return -1;
+        }
+        index = index * 10 + (word[i] - '0');
+    }
+
+    if (prefix == 'R' && index < 16) {
+        return index;
+    }
+    if (prefix == 'V' && word.size() == 2 && index < 8) {
+        isVector = true;
+        return index;
+    }
+    return -1;
+}
@@ -0,0 +1,41 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#pragma once
+
+#include <string_view>
+#include <cstdint>
+
+enum class InstructionType {
+    MOV = 0, ADD = 1, SUB = 2, MUL = 3, DIV = 4, AND = 5, OR = 6, XOR = 7, SHL = 8, SHR = 9, CMP = 10,
+    JMP = 11, JE = 12, JNE = 13, JG = 14, JL = 15, JLE = 16, JGE = 17,
+    LOAD = 18, STORE = 19,
+    PUSH = 20, POP = 21,
+    CALL = 22, RET = 23,
+    PUSHM = 24, POPM = 25, ENTER = 26, LEAVE = 27,
+    CMOVE = 28, CMOVNE = 29, CMOVG = 30, CMOVL = 31, CMOVLE = 32, CMOVGE = 33,
+    SETE = 34, SETNE = 35, SETG = 36, SETL = 37, SETLE = 38, SETGE = 39,
+    LOOP = 40,
+    VLOAD = 41, VSTORE = 42, VADD = 43, VSUB = 44, VMUL = 45, VAND = 46, VXOR = 47,
+    VCMPEQ = 48, VCMPGT = 49, VSPLAT = 50, VEXTRACT = 51,
+    ALLOC = 52, FREE = 53,
+    INVALID = 54
+};
+
+enum class KeywordKind : uint8_t {
+    MNEMONIC,
+    DIRECTIVE   // name without the leading '.'
+};
+
+struct Keyword {
+    std::string_view name;  // upper case
+    KeywordKind kind;
+    InstructionType instr;  // INVALID for directives
+};
+
+// Case-insensitive lookup of a mnemonic or directive name straight from
+// source bytes, nullptr when the word is neither. One hash probe, no
+// allocation.
+const Keyword* findKeyword(std::string_view word);
+
+// R0-R15 give 0-15 and V0-V7 give 0-7 with isVector set, anything else -1
+int32_t registerIndex(std::string_view word, bool& isVector);
@@ -0,0 +1,53 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#include "LabelTable.hpp"
+#include <cctype>
+
+// FNV-1a over the upper-cased bytes
+size_t LabelTable::FoldHash::operator()(std::string_view s) const {
+    uint32_t h = 2166136261u;
+    for (char c : s) {
+        h = (h ^ static_cast<uint8_t>(std::toupper(static_cast<uint8_t>(c)))) * 16777619u;
+    }
+    return h;
+}
+
+bool LabelTable::FoldEqual::operator()(std::string_view a, std::string_view b) const {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (std::toupper(static_cast<uint8_t>(a[i])) != std::toupper(static_cast<uint8_t>(b[i]))) return false;
+    }
+    return true;
+}
+
+int32_t LabelTable::intern(std::string_view name) {
+    auto it = ids_.find(name);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+
+    std::string upper(name);
+    for (auto& ch : upper) ch = static_cast<char>(std::toupper(static_cast<uint8_t>(ch)));
+
+    int32_t id = static_cast<int32_t>(names_.size());
+    names_.push_back(upper);
+    ids_.emplace(std::move(upper), id);
+    return id;
+}
+
+int32_t LabelTable::find(std::string_view name) const {
+    auto it = ids_.find(name);
+    return it != ids_.end() ? it->second : -1;
+}
+
+const std::string& LabelTable::name(int32_t id) const {
+    return names_[id];
+}
+
+const std::vector<std::string>& LabelTable::names() const {
+    return names_;
+}
+
+int32_t LabelTable::size() const {
+    return static_cast<int32_t>(names_.size());
+}
@@ -0,0 +1,39 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Interns label names once and hands out dense integer IDs, so instructions,
+// fixups and symbols refer to a label by number instead of carrying their own
+// copy of the name. Labels are case-insensitive: names are stored upper case
+// and looked up straight from source bytes in any case.
+class LabelTable {
+public:
+    // ID of the name, added on first sight
+    int32_t intern(std::string_view name);
+
+    // ID of the name, -1 if it was never interned
+    int32_t find(std::string_view name) const;
+
+    const std::string& name(int32_t id) const;
+    const std::vector<std::string>& names() const;
+    int32_t size() const;
+
+private:
+    struct FoldHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const;
+    };
+    struct FoldEqual {
+        using is_transparent = void;
+        bool operator()(std::string_view a, std::string_view b) const;
+    };
+
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, int32_t, FoldHash, FoldEqual> ids_;
+};
@@ -1,6 +1,7 @@
 // Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
 
 #include "Lexer.hpp"
+#include <charconv>
 
 std::string tokenTypeName(TokenType t) {
     switch (t) {
@@ -14,12 +15,16 @@ std::string tokenTypeName(TokenType t) {
     case TokenType::T_COLON: return "COLON";
     case TokenType::T_DIRECTIVE: return "DIRECTIVE";
     case TokenType::T_END_OF_FILE: return "END_OF_FILE";
+    case TokenType::T_PLUS: return "PLUS";
+    case TokenType::T_STAR: return "STAR";
+    case TokenType::T_STRING: return "STRING";
+    case TokenType::T_MINUS: return "MINUS";
     default: return "UNKNOWN";
     }
 }
 
 
-Lexer::Lexer(const std::string& input, int32_t lineNumber)
+Lexer::Lexer(std::string_view input, int32_t lineNumber)
     : input_(input), pos_(0), lineNumber_(lineNumber), columnNumber_(1) {
     nextToken();
 }
@@ -30,13 +35,13 @@ const Token& Lexer::currentToken() const {
 
 void Lexer::nextToken() {
     skipSpaces();
-    if (pos_ >= input_.size()) {
-        current_ = { TokenType::T_END_OF_FILE, "", 0, lineNumber_, (int32_t)input_.size() + 1 };
+    if (atLineEnd()) {
+        current_ = { TokenType::T_END_OF_FILE, {}, 0, lineNumber_, tokenEndColumn_ };
         return;
     }
 
     char c = input_[pos_];
-    auto makeToken = [&](TokenType t, const std::string& txt = "", int64_t val = 0) {
+    auto makeToken = [&](TokenType t, std::string_view txt = {}, int64_t val = 0) {
         current_ = { t, txt, val, lineNumber_, columnNumber_ };
         };
 
@@ -56,6 +61,18 @@ void Lexer::nextToken() {
         makeToken(TokenType::T_COLON, ":");
         advance();
     }
+    else if (c == '+') {
+        makeToken(TokenType::T_PLUS, "+");
+        advance();
+    }
+    else if (c == '*') {
+        makeToken(TokenType::T_STAR, "*");
+        advance();
+    }
+    else if (c == '-' && !(pos_ + 1 < input_.size() && std::isdigit((uint8_t)input_[pos_ + 1]))) {
+        makeToken(TokenType::T_MINUS, "-");
+        advance();
+    }
     else if (std::isdigit((uint8_t)c) || (c == '-' && (pos_ + 1 < input_.size()) && std::isdigit((uint8_t)input_[pos_ + 1]))) {
         int startCol = columnNumber_;
         size_t start = pos_;
@@ -63,8 +80,12 @@ void Lexer::nextToken() {
         while (pos_ < input_.size() && std::isdigit((uint8_t)input_[pos_])) {
             advance();
         }
-        std::string numStr = input_.substr(start, pos_ - start);
-        makeToken(TokenType::T_INT, numStr, std::stoll(numStr));
+        std::string_view numStr = input_.substr(start, pos_ - start);
+        int64_t value = 0;
+        if (std::from_chars(input_.data() + start, input_.data() + pos_, value).ec != std::errc()) {
+            error("Integer out of range: " + std::string(numStr));
+        }
+        makeToken(TokenType::T_INT, numStr, value);
         current_.col = startCol;
     }
     else if (std::isalpha((uint8_t)c) || c == '_') {
@@ -74,21 +95,37 @@ void Lexer::nextToken() {
         while (pos_ < input_.size() && (std::isalnum((uint8_t)input_[pos_]) || input_[pos_] == '_')) {
             advance();
         }
-        std::string ident = input_.substr(start, pos_ - start);
-        // Convert to uppercase
-        for (auto& ch : ident) ch = (int8_t)std::toupper((uint8_t)ch);
-
-        if (isInstruction(ident)) {
-            makeToken(TokenType::T_INSTRUCTION, ident);
+        std::string_view word = input_.substr(start, pos_ - start);
+
+        bool isVector = false;
+        int32_t reg = -1;
+        const Keyword* keyword = findKeyword(word);
+        if (keyword && keyword->kind == KeywordKind::MNEMONIC) {
+            makeToken(TokenType::T_INSTRUCTION, keyword->name);
+            current_.instr = keyword->instr;
         }
-        else if (isRegister(ident)) {
-            makeToken(TokenType::T_REGISTER, ident);
+        else if ((reg = registerIndex(word, isVector)) >= 0) {
+            makeToken(TokenType::T_REGISTER, word, reg);
         }
         else {
-            makeToken(TokenType::T_LABEL, ident);
+            // Labels keep their source spelling, the Parser's LabelTable folds case
+            makeToken(TokenType::T_LABEL, word);
         }
         current_.col = startCol;
     }
+    else if (c == '"') {
+        int32_t startCol = columnNumber_;
+        advance();
+        size_t start = pos_;
+        while (pos_ < input_.size() && input_[pos_] != '"' && input_[pos_] != '\n') {
+            advance();
+        }
+        if (pos_ >= input_.size() || input_[pos_] != '"') {
+            error("Unterminated string");
+        }
+        current_ = { TokenType::T_STRING, input_.substr(start, pos_ - start), 0, lineNumber_, startCol };
+        advance();
+    }
     else if (c == '.') {
         advance();
         int32_t startCol = columnNumber_;
@@ -97,32 +134,53 @@ void Lexer::nextToken() {
         while (pos_ < input_.size() && std::isalpha((uint8_t)input_[pos_])) {
             advance();
         }
-        std::string dir = input_.substr(start, pos_ - start);
-        for (auto& ch : dir) ch = (int8_t)std::toupper((uint8_t)ch);
+        std::string_view word = input_.substr(start, pos_ - start);
 
-        if (dir == "DATA" || dir == "CODE" || dir == "WORD") {
-            current_ = { TokenType::T_DIRECTIVE, dir, 0, lineNumber_, startCol };
+        const Keyword* keyword = findKeyword(word);
+        if (keyword && keyword->kind == KeywordKind::DIRECTIVE) {
+            current_ = { TokenType::T_DIRECTIVE, keyword->name, 0, lineNumber_, startCol };
         }
         else {
+            std::string dir(word);
+            for (auto& ch : dir) ch = (int8_t)std::toupper((uint8_t)ch);
             error("Unknown directive: ." + dir);
         }
     }
     else {
         error(std::string("Unexpected character: ") + c);
     }
+    tokenEndColumn_ = columnNumber_;
 }
 
 bool Lexer::ended() const {
     return current_.type == TokenType::T_END_OF_FILE;
 }
 
+bool Lexer::nextLine() {
+    size_t eol = input_.find('\n', pos_);
+    if (eol == std::string_view::npos) {
+        pos_ = input_.size();
+        return false;
+    }
+    pos_ = eol + 1;
+    lineNumber_++;
+    columnNumber_ = 1;
+    tokenEndColumn_ = 1;
+    nextToken();
+    return true;
+}
 
+// '\r' counts as a space so CRLF sources lex like LF ones
 void Lexer::skipSpaces() {
-    while (pos_ < input_.size() && (input_[pos_] == ' ' || input_[pos_] == '\t')) {
+    while (pos_ < input_.size() && (input_[pos_] == ' ' || input_[pos_] == '\t' || input_[pos_] == '\r')) {
         advance();
     }
 }
 
+bool Lexer::atLineEnd() const {
+    return pos_ >= input_.size() || input_[pos_] == '\n' || input_[pos_] == ';';
+}
+
 void Lexer::advance() {
     if (pos_ < input_.size()) {
         pos_++;
@@ -134,21 +192,3 @@ void Lexer::error(const std::string& msg) const {
     throw std::runtime_error("Lexer error at line " + std::to_string(lineNumber_) +
         ", col " + std::to_string(columnNumber_) + ": " + msg);
 }
-
-bool Lexer::isInstruction(const std::string& s) const {
-    static std::unordered_map<std::string, bool> instrs = {
-        {"MOV",true},{"ADD",true},{"SUB",true},{"MUL",true},{"DIV",true},{"AND",true},{"OR",true},
-        {"XOR",true},{"SHL",true},{"SHR",true},{"CMP",true},{"JMP",true},{"JE",true},{"JNE",true},
-        {"JG",true},{"JL",true},{"JLE", true},{"JGE", true},{ "LOAD",true },{"STORE",true},{"PUSH",true},{"POP",true},{"CALL",true},{"RET",true}
-    };
-    return instrs.find(s) != instrs.end();
-}
-
-bool Lexer::isRegister(const std::string& s) const {
-    if (s.size() >= 2 && s[0] == 'R' && std::isdigit((uint8_t)s[1])) {
-        int32_t idx = std::stoi(s.substr(1));
-        return (idx >= 0 && idx < 16);
-    }
-    return false;
-}
-
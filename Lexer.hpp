@@ -4,7 +4,9 @@
 
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include "Keywords.hpp"
 
 enum class TokenType {
     T_INSTRUCTION = 0,
@@ -16,37 +18,49 @@ enum class TokenType {
     T_COMMA = 6,
     T_COLON = 7,
     T_DIRECTIVE = 8,
-    T_END_OF_FILE = 9
+    T_END_OF_FILE = 9,  // end of the current line
+    T_PLUS = 10,
+    T_STAR = 11,
+    T_STRING = 12,      // "..." on one line, text is what is between the quotes
+    T_MINUS = 13        // a '-' not directly followed by a digit
 };
 
 struct Token {
     TokenType type;
-    std::string text;
-    int64_t value;
+    std::string_view text;  // views the source buffer, or the keyword table for mnemonics and directives
+    int64_t value;      // integers, and the index of a register
     int line;
     int col;
+    InstructionType instr = InstructionType::INVALID;  // T_INSTRUCTION only
 };
 
+// Tokenises a buffer in place, the buffer must outlive the Lexer. Tokens stop
+// at the end of each line, where ';' starts a comment; nextLine() moves on to
+// the next one. A buffer holding a single line needs no nextLine().
 class Lexer {
 public:
-    Lexer(const std::string& input, int32_t lineNumber);
+    Lexer(std::string_view input, int32_t lineNumber = 1);
 
     const Token& currentToken() const;
     void nextToken();
+
+    // True once the current line has no tokens left
     bool ended() const;
 
+    // Skips whatever is left of the current line, false at the end of the buffer
+    bool nextLine();
+
 private:
     void skipSpaces();
     void advance();
+    bool atLineEnd() const;
 
     void error(const std::string& msg) const;
 
-    bool isInstruction(const std::string& s) const;
-    bool isRegister(const std::string& s) const;
-
-    std::string input_;
+    std::string_view input_;
     size_t pos_;
     int32_t lineNumber_;
     int32_t columnNumber_;
+    int32_t tokenEndColumn_ = 1;  // just past the last token, where end of line is reported
     Token current_;
 };
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "Linker.hpp"
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
 
 void Linker::addObjectFile(const ObjectFile& objFile) {  
     objectFiles_.push_back(objFile);
@@ -33,35 +34,67 @@ void Linker::debugPrint(const std::string& message) const {
 
 void Linker::buildGlobalSymbolTable() {
     debugPrint("Building global symbol table...");
+    for (size_t i = 0; i < objectFiles_.size(); ++i) {
+        const auto& obj = objectFiles_[i];
+        std::vector<int32_t> ids;
+        ids.reserve(obj.names.size());
+        for (const auto& name : obj.names) {
+            ids.push_back(names_.intern(name));
+        }
+        localToGlobal_.push_back(std::move(ids));
+    }
+    globalSymbolTable_.assign(names_.size(), -1);
+
     for (size_t i = 0; i < objectFiles_.size(); ++i) {
         const auto& obj = objectFiles_[i];
         for (const auto& sym : obj.symbolTable) {
             if (!sym.isExternal) {
-                if (globalSymbolTable_.find(sym.name) != globalSymbolTable_.end()) {
-                    throw std::runtime_error("Multiple definitions of symbol: " + sym.name);
+                int32_t id = localToGlobal_[i][sym.nameId];
+                if (isDefined(id)) {
+                    throw std::runtime_error("Multiple definitions of symbol: " + names_.name(id));
                 }
-                globalSymbolTable_[sym.name] = sym.address;
-                debugPrint("Registered symbol '" + sym.name + "' at address " + std::to_string(sym.address));
+                globalSymbolTable_[id] = sym.address;
+                debugPrint("Registered symbol '" + names_.name(id) + "' at address " + std::to_string(sym.address));
             }
         }
     }
     debugPrint("Global symbol table built.");
 }
 
+bool Linker::isDefined(int32_t nameId) const {
+    return nameId >= 0 && nameId < static_cast<int32_t>(globalSymbolTable_.size()) && globalSymbolTable_[nameId] != -1;
+}
+
 void Linker::collectFixups() {
     debugPrint("Collecting all fixups from object files...");
 
     int32_t accumulatedCodeSegment = 0;
     for (size_t i = 0; i < objectFiles_.size(); ++i) {
-        for (const auto& fix : objectFiles_[i].fixups) {
+        for (Fixup fix : objectFiles_[i].fixups) {
+            fix.symbolId = localToGlobal_[i][fix.symbolId];
             allFixups_.emplace_back(static_cast<int32_t>(i), fix);
-            debugPrint("Collected fixup for symbol '" + fix.symbolName + "' in object file " + std::to_string(i + 1));
+            debugPrint("Collected fixup for symbol '" + names_.name(fix.symbolId) + "' in object file " + std::to_string(i + 1));
         }
     }
     debugPrint("All fixups collected.");
 }
 
-void Linker::resolveFixups(std::vector<uint8_t>& finalImage, int32_t codeOffset) {
+// Reserved symbols that are referenced but defined by no object. A guest
+// definition always wins, so a program can still supply its own __memcpy.
+// A name no object defines is only in the table because a fixup uses it.
+std::vector<int32_t> Linker::collectIntrinsics() const {
+    std::vector<int32_t> used;
+    for (int32_t nameId = 0; nameId < names_.size(); ++nameId) {
+        int32_t id = intrinsicForSymbol(names_.name(nameId));
+        if (id < 0 || isDefined(nameId)) continue;
+        used.push_back(id);
+    }
+    std::sort(used.begin(), used.end());
+    return used;
+}
+
+// dataBases[i] is where object i's data segment starts in the final image
+void Linker::resolveFixups(std::vector<uint8_t>& finalImage, int32_t codeOffset, const std::vector<int32_t>& dataBases) {
     debugPrint("Resolving fixups...");
 
     std::vector<int32_t> cumulativeCodeOffsets(objectFiles_.size(), 0);
@@ -73,22 +106,36 @@ void Linker::resolveFixups(std::vector<uint8_t>& finalImage, int32_t codeOffset)
 
     for (const auto& [objIndex, fix] : allFixups_) {
         int32_t adjustedOffset = fix.bytecodeOffset;
+        bool inData = false;
         if (objIndex != -1)
         {
-            adjustedOffset = fix.bytecodeOffset + cumulativeCodeOffsets[objIndex];
+            int32_t codeSize = static_cast<int32_t>(objectFiles_[objIndex].codeSize);
+            if (fix.bytecodeOffset >= codeSize) {
+                // A data word, e.g. a .jumptable entry
+                adjustedOffset = dataBases[objIndex] + fix.bytecodeOffset - codeSize;
+                inData = true;
+            }
+            else {
+                adjustedOffset = fix.bytecodeOffset + cumulativeCodeOffsets[objIndex];
+            }
         }
 
-        auto it = globalSymbolTable_.find(fix.symbolName);
-        if (it != globalSymbolTable_.end()) {
-            int32_t symbolAddr = it->second;
-            debugPrint("Resolved symbol '" + fix.symbolName + "' to address " + std::to_string(symbolAddr));
+        if (isDefined(fix.symbolId)) {
+            int32_t symbolAddr = globalSymbolTable_[fix.symbolId];
+            debugPrint("Resolved symbol '" + names_.name(fix.symbolId) + "' to address " + std::to_string(symbolAddr));
 
             if (adjustedOffset + 3 >= static_cast<int32_t>(finalImage.size())) {
-                throw std::runtime_error("Fixup address out of range for symbol: " + fix.symbolName);
+                throw std::runtime_error("Fixup address out of range for symbol: " + names_.name(fix.symbolId));
             }
 
-            uint8_t operandType = fix.isMemoryReference ? static_cast<uint8_t>(2) : static_cast<uint8_t>(0);
-            finalImage[adjustedOffset - 1] = operandType;
+            // Type 4 is the label placeholder, indexed operands (type 5) keep their own type
+            if (!inData && finalImage[adjustedOffset - 1] == 4) {
+                uint8_t operandType = fix.isMemoryReference ? static_cast<uint8_t>(2) : static_cast<uint8_t>(0);
+                finalImage[adjustedOffset - 1] = operandType;
+            }
+
+            // The placeholder holds the addend, e.g. the 4 in [table+4]
+            symbolAddr += readInt32(finalImage, adjustedOffset);
 
             finalImage[adjustedOffset] = static_cast<uint8_t>(symbolAddr & 0xFF);
             finalImage[adjustedOffset + 1] = static_cast<uint8_t>((symbolAddr >> 8) & 0xFF);
@@ -99,19 +146,42 @@ void Linker::resolveFixups(std::vector<uint8_t>& finalImage, int32_t codeOffset)
                 " with address " + std::to_string(symbolAddr));
         }
         else {
-            throw std::runtime_error("Undefined symbol during linking: " + fix.symbolName);
+            throw std::runtime_error("Undefined symbol during linking: " + names_.name(fix.symbolId));
         }
     }
     debugPrint("All fixups resolved.");
 }
 
+const std::vector<Symbol>& Linker::getSymbols() const {
+    return linkedSymbols_;
+}
+
+const std::vector<std::string>& Linker::getSymbolNames() const {
+    return names_.names();
+}
+
+int32_t Linker::getBits() const {
+    return bits_;
+}
+
 std::vector<uint8_t> Linker::link() {
     debugPrint("Starting linking process...");
 
+    // 32 and 64-bit objects disagree on stack slot and LOAD/STORE sizes, they cannot be mixed
+    if (!objectFiles_.empty()) {
+        bits_ = objectFiles_[0].bits;
+    }
+    for (size_t i = 1; i < objectFiles_.size(); ++i) {
+        if (objectFiles_[i].bits != bits_) {
+            throw std::runtime_error("Cannot link 32-bit and 64-bit object files together (object file " +
+                std::to_string(i + 1) + ")");
+        }
+    }
+
     buildGlobalSymbolTable();
 
-    auto mainIt = globalSymbolTable_.find("MAIN");
-    if (mainIt == globalSymbolTable_.end()) {
+    int32_t mainId = names_.find("MAIN");
+    if (!isDefined(mainId)) {
         throw std::runtime_error("Entry point 'main' not found.");
     }
 
@@ -121,19 +191,14 @@ std::vector<uint8_t> Linker::link() {
 
     uint32_t mainOffset = 6;
 
-    for (auto& [findex, fix] : allFixups_)
-    {
-        fix.bytecodeOffset += mainOffset;
-    }
 
-    
     finalImage.push_back(BC_JMP); // JMP opcode
     finalImage.push_back(0x00); // Operand type 0 (Immediate)
     finalImage.insert(finalImage.end(), { 0x00, 0x00, 0x00, 0x00 }); 
 
     Fixup mainFix;
     mainFix.bytecodeOffset = 2;
-    mainFix.symbolName = "MAIN";
+    mainFix.symbolId = mainId;
     mainFix.isDataLabel = false;
     mainFix.isMemoryReference = false;
     allFixups_.emplace_back(-1, mainFix);
@@ -141,12 +206,18 @@ std::vector<uint8_t> Linker::link() {
 
     debugPrint("Inserted JMP to 'main' at bytecode offset 0");
 
+    // Each intrinsic gets a "NATIVE id" stub after the code, CALL lands there
+    // and the VM runs the routine and returns in a single instruction
+    std::vector<int32_t> intrinsics = collectIntrinsics();
+    const int32_t stubSize = 6;
+
     int32_t totalCodeSize = mainOffset;
     int32_t totalDataSize = 0;
     for (const auto& obj : objectFiles_) {
         totalCodeSize += static_cast<int32_t>(obj.codeSegment.size());
         totalDataSize += static_cast<int32_t>(obj.dataSegment.size());
     }
+    totalCodeSize += stubSize * static_cast<int32_t>(intrinsics.size());
 
     debugPrint("Total code size (including JMP): " + std::to_string(totalCodeSize) + " bytes");
     debugPrint("Total data size: " + std::to_string(totalDataSize) + " bytes");
@@ -162,6 +233,23 @@ std::vector<uint8_t> Linker::link() {
         currentCodeOffset += static_cast<int32_t>(objectFiles_[i].codeSegment.size());
     }
 
+    for (int32_t id : intrinsics) {
+        std::string name = intrinsicName(id);
+        int32_t nameId = names_.find(name);
+        globalSymbolTable_[nameId] = currentCodeOffset;
+
+        Symbol linked;
+        linked.nameId = nameId;
+        linked.address = currentCodeOffset;
+        linkedSymbols_.push_back(linked);
+
+        finalImage.push_back(BC_NATIVE);
+        finalImage.push_back(0x00);
+        finalImage.insert(finalImage.end(), { static_cast<uint8_t>(id), 0x00, 0x00, 0x00 });
+        debugPrint("Bound intrinsic '" + name + "' to native stub at " + std::to_string(currentCodeOffset));
+        currentCodeOffset += stubSize;
+    }
+
     int32_t dataStartOffset = currentCodeOffset;
     std::vector<int32_t> dataOffsets;
 
@@ -173,9 +261,11 @@ std::vector<uint8_t> Linker::link() {
     }
 
     int32_t dataOffset = 0;
+    std::vector<int32_t> dataBases;
     for (size_t i = 0; i < objectFiles_.size(); ++i)
     {
         dataOffsets.push_back(dataOffset);
+        dataBases.push_back(dataStartOffset + dataOffset);
         dataOffset += static_cast<int32_t>(objectFiles_[i].dataSegment.size());
     }
 
@@ -183,22 +273,28 @@ std::vector<uint8_t> Linker::link() {
         for (const auto& sym : objectFiles_[i].symbolTable) {
             if (!sym.isExternal) 
             {
-                globalSymbolTable_[sym.name] = sym.address;
+                int32_t id = localToGlobal_[i][sym.nameId];
+                globalSymbolTable_[id] = sym.address;
 
                 if (sym.isData)
                 {
-                    globalSymbolTable_[sym.name] += dataStartOffset + dataOffsets[i] - static_cast<int32_t>(objectFiles_[i].codeSize);//dataOffsets[i] - objectFiles_[i].codeSize;
+                    globalSymbolTable_[id] += dataStartOffset + dataOffsets[i] - static_cast<int32_t>(objectFiles_[i].codeSize);//dataOffsets[i] - objectFiles_[i].codeSize;
                 }
                 else
                 {
-                    globalSymbolTable_[sym.name] += codeOffsets[i]; // need to use the codeoffset tables as we link multiple code segments and the offset is variable
+                    globalSymbolTable_[id] += codeOffsets[i]; // need to use the codeoffset tables as we link multiple code segments and the offset is variable
                 }
-                debugPrint("Symbol '" + sym.name + "' assigned address " + std::to_string(globalSymbolTable_[sym.name]));
+                debugPrint("Symbol '" + names_.name(id) + "' assigned address " + std::to_string(globalSymbolTable_[id]));
+
+                Symbol linked = sym;
+                linked.nameId = id;
+                linked.address = globalSymbolTable_[id];
+                linkedSymbols_.push_back(linked);
             }
         }
     }
 
-    resolveFixups(finalImage, 0);
+    resolveFixups(finalImage, static_cast<int32_t>(mainOffset), dataBases);
 
     debugPrint("Linking process completed successfully.");
     debugPrint("Final memory image size: " + std::to_string(finalImage.size()) + " bytes");
@@ -4,6 +4,7 @@
 
 #include "ObjectFile.hpp"
 #include "Utility.hpp" 
+#include "LabelTable.hpp"
 #include <vector>
 #include <unordered_map>
 #include <string>
@@ -18,14 +19,30 @@ public:
 
     std::vector<uint8_t> link();
 
+    // Symbols with their final image addresses, valid after link(). Their
+    // nameId indexes getSymbolNames().
+    const std::vector<Symbol>& getSymbols() const;
+    const std::vector<std::string>& getSymbolNames() const;
+
+    // Register width of the linked image, valid after link()
+    int32_t getBits() const;
+
 private:
     std::vector<ObjectFile> objectFiles_;
-    std::unordered_map<std::string, int32_t> globalSymbolTable_;
+    // Every object's names interned once; the tables below are indexed by
+    // these global IDs, and localToGlobal_[i] maps object i's name IDs
+    LabelTable names_;
+    std::vector<std::vector<int32_t>> localToGlobal_;
+    std::vector<int32_t> globalSymbolTable_;    // address, -1 while undefined
+    std::vector<Symbol> linkedSymbols_;
     std::vector<std::pair<int32_t, Fixup>> allFixups_;
+    int32_t bits_ = 32;
     bool debug_;
 
     void buildGlobalSymbolTable();
+    bool isDefined(int32_t nameId) const;
     void collectFixups();
-    void resolveFixups(std::vector<uint8_t>& finalImage, int32_t codeOffset);
+    std::vector<int32_t> collectIntrinsics() const;
+    void resolveFixups(std::vector<uint8_t>& finalImage, int32_t codeOffset, const std::vector<int32_t>& dataBases);
     void debugPrint(const std::string& message) const;
 };
@@ -0,0 +1,30 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#include "ModuleCache.hpp"
+#include "Parser.hpp"
+
+std::shared_ptr<const Parser> ModuleCache::find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = modules_.find(key);
+    if (it == modules_.end()) {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    return it->second;
+}
+
+std::shared_ptr<const Parser> ModuleCache::insert(const std::string& key, std::shared_ptr<const Parser> module) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return modules_.emplace(key, std::move(module)).first->second;
+}
+
+int32_t ModuleCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+int32_t ModuleCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
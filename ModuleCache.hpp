@@ -0,0 +1,31 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class Parser;
+
+// Files pulled in with .include, parsed once per build and shared by every
+// source that includes them. Keys come from the Parser and cover the file's
+// content and the state it was parsed in. Safe to use from several threads;
+// two threads asking for the same new module may both parse it, and the first
+// to finish is kept.
+class ModuleCache {
+public:
+    std::shared_ptr<const Parser> find(const std::string& key);
+    std::shared_ptr<const Parser> insert(const std::string& key, std::shared_ptr<const Parser> module);
+
+    // Lookups answered from the cache and modules parsed, reported with -O
+    int32_t hits() const;
+    int32_t misses() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<const Parser>> modules_;
+    int32_t hits_ = 0;
+    int32_t misses_ = 0;
+};
@@ -0,0 +1,129 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#include "ObjectCache.hpp"
+#include "Utility.hpp"
+#include "Parser.hpp"
+#include "SourceFile.hpp"
+#include "Optimizer.hpp"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+
+// Part of every key: bump it whenever a change to the lexer, parser or
+// compiler changes the bytes produced for the same source. Optimizer changes
+// bump Optimizer::VERSION instead.
+static constexpr std::string_view ASSEMBLER_VERSION = "slam-obj-1";
+
+ObjectCache::ObjectCache(const std::string& directory, bool debug)
+    : directory_(directory), debug_(debug) {
+    std::filesystem::create_directories(directory_);
+}
+
+// Names in the .include lines of source, in order
+static std::vector<std::string_view> includedNames(std::string_view source) {
+    std::vector<std::string_view> names;
+    size_t pos = 0;
+    while (pos < source.size()) {
+        size_t eol = source.find('\n', pos);
+        if (eol == std::string_view::npos) eol = source.size();
+        std::string_view line = source.substr(pos, eol - pos);
+        pos = eol + 1;
+
+        size_t p = line.find_first_not_of(" \t\r");
+        if (p == std::string_view::npos || line.size() - p < 8 || line[p] != '.') continue;
+        bool include = true;
+        for (size_t i = 0; i < 7; i++) {
+            include = include && std::toupper(static_cast<uint8_t>(line[p + 1 + i])) == "INCLUDE"[i];
+        }
+        size_t open = include ? line.find('"', p + 8) : std::string_view::npos;
+        size_t close = open != std::string_view::npos ? line.find('"', open + 1) : std::string_view::npos;
+        if (close != std::string_view::npos) {
+            names.push_back(line.substr(open + 1, close - open - 1));
+        }
+    }
+    return names;
+}
+
+// 64-bit FNV-1a over the versions, options, the source and each included
+// file in the order they are first included, plus the source length
+std::string ObjectCache::key(std::string_view source, const std::string& directory, bool optimize) {
+    uint64_t hash = hashBytes(ASSEMBLER_VERSION);
+    auto mix = [&](std::string_view bytes) {
+        hash = hashBytes(bytes, hashBytes("\xFF", hash));
+    };
+    mix(optimize ? "O1." + std::to_string(Optimizer::VERSION) : "O0");
+    mix(source);
+
+    std::vector<std::string> seen;
+    std::function<bool(std::string_view, const std::string&)> mixIncludes =
+        [&](std::string_view text, const std::string& dir) {
+        for (std::string_view name : includedNames(text)) {
+            std::string path = Parser::resolveInclude(name, dir);
+            if (std::find(seen.begin(), seen.end(), path) != seen.end()) continue;
+            seen.push_back(path);
+            try {
+                SourceFile included(path);
+                mix(path);
+                mix(included.text());
+                if (!mixIncludes(included.text(), std::filesystem::path(path).parent_path().string())) return false;
+            }
+            catch (const std::exception&) {
+                return false;
+            }
+        }
+        return true;
+        };
+    if (!mixIncludes(source, directory)) {
+        return "";
+    }
+
+    std::ostringstream out;
+    out << std::hex << std::setfill('0') << std::setw(16) << hash << "-" << source.size();
+    return out.str();
+}
+
+std::string ObjectCache::pathFor(const std::string& key) const {
+    return (std::filesystem::path(directory_) / (key + ".obj")).string();
+}
+
+bool ObjectCache::load(const std::string& key, ObjectFile& obj) const {
+    std::string path = pathFor(key);
+    if (!std::filesystem::exists(path)) {
+        debugPrint("Miss " + key);
+        return false;
+    }
+    try {
+        obj = ReadObjectFile(path);
+    }
+    catch (const std::exception& ex) {
+        debugPrint("Unreadable entry " + key + ": " + ex.what());
+        return false;
+    }
+    debugPrint("Hit " + key);
+    return true;
+}
+
+// Written under a name private to this thread, then renamed into place
+void ObjectCache::store(const std::string& key, const ObjectFile& obj) const {
+    std::string path = pathFor(key);
+    std::string temp = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    WriteObjectFile(obj, temp);
+
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    if (ec) {
+        std::filesystem::remove(temp, ec);
+    }
+    debugPrint("Stored " + key);
+}
+
+void ObjectCache::debugPrint(const std::string& message) const {
+    if (debug_) {
+        std::cout << "[ObjectCache Debug] " << message << "\n";
+    }
+}
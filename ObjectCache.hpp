@@ -0,0 +1,33 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#pragma once
+
+#include "ObjectFile.hpp"
+#include <string>
+#include <string_view>
+
+// Content-addressed store of assembled objects. An entry is keyed by a hash of
+// the source text, the assembler version and every option that changes the
+// output, so a hit can stand in for lexing, parsing and compiling the source.
+// Entries are ordinary object files and are written atomically, so parallel
+// builds may share a cache directory.
+class ObjectCache {
+public:
+    ObjectCache(const std::string& directory, bool debug = false);
+
+    // Covers the source and, through its .include lines, every file it
+    // includes; directory is where the source is. Empty if an included file
+    // cannot be read, which leaves the source to be assembled and fail there.
+    static std::string key(std::string_view source, const std::string& directory, bool optimize);
+
+    // False on a miss, or when the entry cannot be read
+    bool load(const std::string& key, ObjectFile& obj) const;
+    void store(const std::string& key, const ObjectFile& obj) const;
+
+private:
+    std::string pathFor(const std::string& key) const;
+    void debugPrint(const std::string& message) const;
+
+    std::string directory_;
+    bool debug_;
+};
@@ -3,6 +3,7 @@
 #include "ObjectFile.hpp"
 #include <fstream>
 #include <stdexcept>
+#include <unordered_map>
 
 void WriteString(std::ofstream& ofs, const std::string& str) {
     size_t length = str.size();
@@ -68,7 +69,7 @@ void WriteObjectFile(const ObjectFile& obj, const std::string& path) {
         throw std::runtime_error("Failed to write symbolTable size to file.");
     }
     for (const auto& symbol : obj.symbolTable) {
-        WriteString(ofs, symbol.name);
+        WriteString(ofs, obj.names[symbol.nameId]);
         ofs.write(reinterpret_cast<const char*>(&symbol.address), sizeof(symbol.address));
         ofs.write(reinterpret_cast<const char*>(&symbol.isExternal), sizeof(symbol.isExternal));
         ofs.write(reinterpret_cast<const char*>(&symbol.isData), sizeof(symbol.isData));
@@ -84,7 +85,7 @@ void WriteObjectFile(const ObjectFile& obj, const std::string& path) {
     }
     for (const auto& fixup : obj.fixups) {
         ofs.write(reinterpret_cast<const char*>(&fixup.bytecodeOffset), sizeof(fixup.bytecodeOffset));
-        WriteString(ofs, fixup.symbolName);
+        WriteString(ofs, obj.names[fixup.symbolId]);
         ofs.write(reinterpret_cast<const char*>(&fixup.isDataLabel), sizeof(fixup.isDataLabel));
         ofs.write(reinterpret_cast<const char*>(&fixup.isMemoryReference), sizeof(fixup.isMemoryReference));
         if (!ofs) {
@@ -92,6 +93,11 @@ void WriteObjectFile(const ObjectFile& obj, const std::string& path) {
         }
     }
 
+    ofs.write(reinterpret_cast<const char*>(&obj.bits), sizeof(obj.bits));
+    if (!ofs) {
+        throw std::runtime_error("Failed to write bits to file.");
+    }
+
     ofs.close();
     if (!ofs) {
         throw std::runtime_error("Failed to finalize writing to file: " + path);
@@ -106,6 +112,20 @@ ObjectFile ReadObjectFile(const std::string& path) {
 
     ObjectFile obj;
 
+    // Names are stored inline with each symbol and fixup, rebuild the table from them
+    std::unordered_map<std::string, int32_t> nameIds;
+    auto readName = [&]() {
+        std::string name = ReadString(ifs);
+        auto it = nameIds.find(name);
+        if (it != nameIds.end()) {
+            return it->second;
+        }
+        int32_t id = static_cast<int32_t>(obj.names.size());
+        nameIds.emplace(name, id);
+        obj.names.push_back(std::move(name));
+        return id;
+    };
+
     ifs.read(reinterpret_cast<char*>(&obj.codeSize), sizeof(obj.codeSize));
     if (!ifs) {
         throw std::runtime_error("Failed to read codeSize from file.");
@@ -145,7 +165,7 @@ ObjectFile ReadObjectFile(const std::string& path) {
     obj.symbolTable.reserve(symbolTableSize);
     for (size_t i = 0; i < symbolTableSize; ++i) {
         Symbol symbol;
-        symbol.name = ReadString(ifs);
+        symbol.nameId = readName();
         ifs.read(reinterpret_cast<char*>(&symbol.address), sizeof(symbol.address));
         ifs.read(reinterpret_cast<char*>(&symbol.isExternal), sizeof(symbol.isExternal));
         ifs.read(reinterpret_cast<char*>(&symbol.isData), sizeof(symbol.isData));
@@ -164,7 +184,7 @@ ObjectFile ReadObjectFile(const std::string& path) {
     for (size_t i = 0; i < fixupsSize; ++i) {
         Fixup fixup;
         ifs.read(reinterpret_cast<char*>(&fixup.bytecodeOffset), sizeof(fixup.bytecodeOffset));
-        fixup.symbolName = ReadString(ifs);
+        fixup.symbolId = readName();
         ifs.read(reinterpret_cast<char*>(&fixup.isDataLabel), sizeof(fixup.isDataLabel));
         ifs.read(reinterpret_cast<char*>(&fixup.isMemoryReference), sizeof(fixup.isMemoryReference));
         if (!ifs) {
@@ -173,10 +193,15 @@ ObjectFile ReadObjectFile(const std::string& path) {
         obj.fixups.push_back(std::move(fixup));
     }
 
-    ifs.close();
-    if (!ifs) {
-        throw std::runtime_error("Failed to finalize reading from file: " + path);
+    // Objects written before 64-bit mode existed end here and are 32-bit
+    if (ifs.peek() != std::ifstream::traits_type::eof()) {
+        ifs.read(reinterpret_cast<char*>(&obj.bits), sizeof(obj.bits));
+        if (!ifs || (obj.bits != 32 && obj.bits != 64)) {
+            throw std::runtime_error("Failed to read bits from file.");
+        }
     }
 
+    ifs.close();
+
     return obj;
 }
\ No newline at end of file
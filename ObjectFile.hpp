@@ -6,8 +6,10 @@
 #include <vector>
 #include <unordered_map>
 
+// Symbols and fixups name their label by index into a names table: the
+// ObjectFile's own for objects, the Linker's for linked symbols
 struct Symbol {
-    std::string name;
+    int32_t nameId;
     int32_t address;
     bool isExternal = false;
     bool isData = false;
@@ -15,7 +17,7 @@ struct Symbol {
 
 struct Fixup {
     int32_t bytecodeOffset;
-    std::string symbolName;
+    int32_t symbolId;
     bool isDataLabel;
     bool isMemoryReference;
 };
@@ -25,7 +27,9 @@ struct ObjectFile {
     std::vector<uint8_t> dataSegment;
     std::vector<Symbol> symbolTable;
     std::vector<Fixup> fixups;
+    std::vector<std::string> names;
     size_t codeSize;
+    int32_t bits = 32; // register width the code was assembled for, 32 or 64
 };
 
 void WriteObjectFile(const ObjectFile& obj, const std::string& path);
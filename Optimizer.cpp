@@ -0,0 +1,1026 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#include "Optimizer.hpp"
+#include <iostream>
+#include <array>
+#include <deque>
+#include <algorithm>
+
+static bool isLabelDef(const Instruction& ins) {
+    return ins.type == InstructionType::INVALID;
+}
+
+static bool isPlainReg(const Operand& op) {
+    return op.isRegister && !op.isMemory && !op.isVector;
+}
+
+static bool isPlainReg(const Operand& op, int32_t reg) {
+    return isPlainReg(op) && op.regIndex == reg;
+}
+
+static bool isImm(const Operand& op) {
+    return !op.isRegister && !op.isMemory && !op.isLabel;
+}
+
+static bool isImm(const Operand& op, int64_t value) {
+    return isImm(op) && op.immediate == value;
+}
+
+// R0-R13. R14 is the stack pointer and a write to R15 is a jump, so the
+// peephole rules never rewrite or drop an instruction that writes either.
+static bool isDataReg(const Operand& op) {
+    return isPlainReg(op) && op.regIndex < 14;
+}
+
+// A jump straight to a label, not through a register or table
+static bool isDirectTarget(const Operand& op) {
+    return op.isLabel && !op.isMemory && op.indexReg == -1;
+}
+
+static bool readsRegister(const Operand& op, int32_t reg) {
+    return (op.isRegister && !op.isVector && op.regIndex == reg) || op.indexReg == reg;
+}
+
+static bool isJump(InstructionType t) {
+    switch (t) {
+    case InstructionType::JMP: case InstructionType::JE: case InstructionType::JNE:
+    case InstructionType::JG: case InstructionType::JL: case InstructionType::JLE:
+    case InstructionType::JGE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// 2^k for k in 1..30, the shifts that mean the same in 32- and 64-bit mode
+static int32_t powerOfTwo(const Operand& op) {
+    if (!isImm(op) || op.immediate < 2 || op.immediate > (1 << 30) || (op.immediate & (op.immediate - 1)) != 0) {
+        return 0;
+    }
+    int32_t k = 0;
+    while ((int64_t(1) << k) != op.immediate) k++;
+    return k;
+}
+
+static bool isControlTransfer(InstructionType t) {
+    switch (t) {
+    case InstructionType::JMP: case InstructionType::JE: case InstructionType::JNE:
+    case InstructionType::JG: case InstructionType::JL: case InstructionType::JLE:
+    case InstructionType::JGE: case InstructionType::CALL: case InstructionType::RET:
+    case InstructionType::LOOP:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Conservative: anything we do not recognise is assumed to write every register
+static bool writesRegister(const Instruction& ins, int32_t reg) {
+    switch (ins.type) {
+    case InstructionType::CMP:
+        return false;
+    case InstructionType::PUSH:
+        return reg == 14;
+    case InstructionType::PUSHM:
+        return reg == 14;
+    case InstructionType::POPM:
+        if (reg == 14) return true;
+        for (const auto& op : ins.operands) {
+            if (op.isRegister ? op.regIndex == reg : ((op.immediate >> reg) & 1) != 0) return true;
+        }
+        return false;
+    case InstructionType::ENTER: case InstructionType::LEAVE:
+        return reg == 13 || reg == 14;
+    case InstructionType::VLOAD: case InstructionType::VSTORE: case InstructionType::VADD:
+    case InstructionType::VSUB: case InstructionType::VMUL: case InstructionType::VAND:
+    case InstructionType::VXOR: case InstructionType::VCMPEQ: case InstructionType::VCMPGT:
+    case InstructionType::VSPLAT: case InstructionType::FREE:
+        return false;
+    case InstructionType::VEXTRACT:
+        return isPlainReg(ins.operands[0], reg);
+    case InstructionType::POP:
+        return reg == 14 || isPlainReg(ins.operands[0], reg);
+    case InstructionType::MOV: case InstructionType::ADD: case InstructionType::SUB:
+    case InstructionType::MUL: case InstructionType::DIV: case InstructionType::AND:
+    case InstructionType::OR: case InstructionType::XOR: case InstructionType::SHL:
+    case InstructionType::SHR: case InstructionType::LOAD: case InstructionType::STORE:
+    case InstructionType::CMOVE: case InstructionType::CMOVNE: case InstructionType::CMOVG:
+    case InstructionType::CMOVL: case InstructionType::CMOVLE: case InstructionType::CMOVGE:
+    case InstructionType::SETE: case InstructionType::SETNE: case InstructionType::SETG:
+    case InstructionType::SETL: case InstructionType::SETLE: case InstructionType::SETGE:
+    case InstructionType::ALLOC:
+        return isPlainReg(ins.operands[0], reg);
+    default:
+        return true;
+    }
+}
+
+static Instruction makeLabel(int32_t labelId, const Instruction& at) {
+    Instruction ins{};
+    ins.type = InstructionType::INVALID;
+    ins.labelId = labelId;
+    ins.line = at.line;
+    ins.col = at.col;
+    return ins;
+}
+
+static Operand makeLabelOperand(int32_t labelId, const Instruction& at) {
+    Operand op{};
+    op.isLabel = true;
+    op.labelId = labelId;
+    op.line = at.line;
+    op.col = at.col;
+    return op;
+}
+
+static Operand makeImmOperand(int64_t value, const Instruction& at) {
+    Operand op{};
+    op.immediate = value;
+    op.line = at.line;
+    op.col = at.col;
+    return op;
+}
+
+static Instruction makeInstruction(InstructionType type, const Instruction& at, const Operand& a, const Operand& b) {
+    Instruction ins{};
+    ins.type = type;
+    ins.line = at.line;
+    ins.col = at.col;
+    ins.operands.push_back(a);
+    ins.operands.push_back(b);
+    return ins;
+}
+
+static Instruction makeInstruction(InstructionType type, const Instruction& at, const Operand& a, const Operand& b,
+    const Operand& c) {
+    Instruction ins = makeInstruction(type, at, a, b);
+    ins.operands.push_back(c);
+    return ins;
+}
+
+std::vector<Instruction> Optimizer::optimize(const std::vector<Instruction>& instructions, LabelTable& labels) {
+    std::vector<Instruction> code = instructions;
+    internalLabels_.assign(labels.size(), false);
+
+    debugPrint("Optimizing " + std::to_string(code.size()) + " instructions...");
+    rewriteCountedLoops(code, labels);
+
+    // Each rewrite can expose another, e.g. MUL by 1 becomes a MOV to itself,
+    // and propagating it leaves a dead store
+    for (int32_t pass = 0; pass < MAX_PASSES; pass++) {
+        bool changed = simplifyArithmetic(code);
+        changed = removeRedundantMoves(code) || changed;
+        changed = threadJumps(code) || changed;
+        changed = removeUnreachableBlocks(code) || changed;
+        changed = propagateValues(code) || changed;
+        changed = removeDeadStores(code) || changed;
+        changed = optimizeLoops(code, labels) || changed;
+        if (!changed) break;
+    }
+
+    debugPrint("Optimization finished, " + std::to_string(code.size()) + " instructions remain.");
+
+    return code;
+}
+
+// top:  cmp rN, 0              top:  cmp rN, 0
+//       jle exit                     jle exit
+//       <body>            =>   top.BODY:
+//       sub rN, rN, 1                <body>
+//       jmp top                      loop rN, top.BODY
+// exit:                        exit:
+//
+// Valid when the body is straight-line, has no labels and never writes rN:
+// rN is then >= 1 on every pass, so "rN - 1 <= 0" is exactly "rN - 1 == 0".
+// LOOP sets the flags as "cmp rN, 0" would, so the body and the code at exit
+// see the same flags as before. '.' cannot appear in a source identifier, so the
+// generated label cannot clash with user labels.
+void Optimizer::rewriteCountedLoops(std::vector<Instruction>& code, LabelTable& labels) {
+    std::vector<Instruction> out;
+    out.reserve(code.size());
+
+    size_t i = 0;
+    while (i < code.size()) {
+        const Instruction& top = code[i];
+        bool rewritten = false;
+
+        if (isLabelDef(top) && i + 2 < code.size()) {
+            const Instruction& cmp = code[i + 1];
+            const Instruction& jle = code[i + 2];
+
+            if (cmp.type == InstructionType::CMP && cmp.operands[0].isRegister && !cmp.operands[0].isMemory &&
+                cmp.operands[0].regIndex < 14 && isImm(cmp.operands[1], 0) &&
+                jle.type == InstructionType::JLE && jle.operands[0].isLabel && !jle.operands[0].isMemory &&
+                jle.operands[0].labelId != top.labelId) {
+
+                int32_t reg = cmp.operands[0].regIndex;
+                int32_t exitLabel = jle.operands[0].labelId;
+
+                // Find "sub rN, rN, 1 / jmp top" at the end of a clean body
+                size_t j = i + 3;
+                bool found = false;
+                while (j + 1 < code.size()) {
+                    const Instruction& ins = code[j];
+                    if (ins.type == InstructionType::SUB && isPlainReg(ins.operands[0], reg) &&
+                        isPlainReg(ins.operands[1], reg) && isImm(ins.operands[2], 1) &&
+                        code[j + 1].type == InstructionType::JMP && code[j + 1].operands[0].isLabel &&
+                        !code[j + 1].operands[0].isMemory && code[j + 1].operands[0].labelId == top.labelId) {
+                        found = true;
+                        break;
+                    }
+                    if (isLabelDef(ins) || isControlTransfer(ins.type) || writesRegister(ins, reg)) {
+                        break;
+                    }
+                    j++;
+                }
+
+                if (found) {
+                    const Instruction& sub = code[j];
+                    int32_t bodyLabel = makeInternalLabel(labels, labels.name(top.labelId) + ".BODY");
+
+                    out.push_back(top);
+                    out.push_back(cmp);
+                    out.push_back(jle);
+                    out.push_back(makeLabel(bodyLabel, sub));
+                    for (size_t k = i + 3; k < j; k++) {
+                        out.push_back(code[k]);
+                    }
+
+                    Instruction loop{};
+                    loop.type = InstructionType::LOOP;
+                    loop.line = sub.line;
+                    loop.col = sub.col;
+                    loop.operands.push_back(sub.operands[0]);
+                    loop.operands.push_back(makeLabelOperand(bodyLabel, sub));
+                    out.push_back(loop);
+
+                    // Falling out of LOOP must land where "jmp top; jle exit" would have
+                    bool exitFollows = j + 2 < code.size() && isLabelDef(code[j + 2]) && code[j + 2].labelId == exitLabel;
+                    if (!exitFollows) {
+                        Instruction jmp{};
+                        jmp.type = InstructionType::JMP;
+                        jmp.line = sub.line;
+                        jmp.col = sub.col;
+                        jmp.operands.push_back(makeLabelOperand(exitLabel, sub));
+                        out.push_back(jmp);
+                    }
+
+                    hit("counted-loop", top);
+                    i = j + 2;
+                    rewritten = true;
+                }
+            }
+        }
+
+        if (!rewritten) {
+            out.push_back(code[i]);
+            i++;
+        }
+    }
+
+    code.swap(out);
+}
+
+// ALU instructions leave the flags alone, so every rewrite here only has to
+// keep the destination's value:
+//   ADD d, s, 0 / ADD d, 0, s / SUB d, s, 0  =>  MOV d, s
+//   MUL d, s, 1 / MUL d, 1, s / DIV d, s, 1  =>  MOV d, s
+//   MUL d, d, 2^k / MUL d, 2^k, d            =>  SHL d, k
+// where d is one of R0-R13 and s a register or immediate. A MOV to itself is
+// then dropped by removeRedundantMoves. MUL wraps like SHL does. DIV by 2^k is
+// left alone: DIV is signed and rounds toward zero, SHR is a logical shift, so
+// they differ for negative dividends.
+bool Optimizer::simplifyArithmetic(std::vector<Instruction>& code) {
+    bool changed = false;
+    for (auto& ins : code) {
+        if (ins.type != InstructionType::ADD && ins.type != InstructionType::SUB &&
+            ins.type != InstructionType::MUL && ins.type != InstructionType::DIV) {
+            continue;
+        }
+        const Operand& dst = ins.operands[0];
+        const Operand& a = ins.operands[1];
+        const Operand& b = ins.operands[2];
+        if (!isDataReg(dst)) continue;
+
+        bool commutes = ins.type == InstructionType::ADD || ins.type == InstructionType::MUL;
+        int64_t identity = (ins.type == InstructionType::ADD || ins.type == InstructionType::SUB) ? 0 : 1;
+        auto isSource = [](const Operand& op) { return isPlainReg(op) || isImm(op); };
+
+        const Operand* source = nullptr;
+        if (isImm(b, identity) && isSource(a)) source = &a;
+        else if (commutes && isImm(a, identity) && isSource(b)) source = &b;
+        if (source) {
+            std::string rule = identity == 0 ? "add-zero" : "mul-one";
+            ins = makeInstruction(InstructionType::MOV, ins, dst, *source);
+            hit(rule, ins);
+            changed = true;
+            continue;
+        }
+
+        if (ins.type == InstructionType::MUL) {
+            int32_t shift = 0;
+            if (isPlainReg(a, dst.regIndex)) shift = powerOfTwo(b);
+            if (shift == 0 && isPlainReg(b, dst.regIndex)) shift = powerOfTwo(a);
+            if (shift != 0) {
+                ins = makeInstruction(InstructionType::SHL, ins, dst, makeImmOperand(shift, ins));
+                hit("mul-pow2", ins);
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+// Moves between registers that change nothing, with no label in between:
+//   MOV rX, rX                        =>  (nothing)
+//   MOV rA, rB / MOV rB, rA           =>  MOV rA, rB
+//   MOV rA, s / MOV rA, t             =>  MOV rA, t     t does not read rA
+// where the destinations are R0-R13. The overwritten MOV may only read a
+// register, immediate or label address: dropping a memory read could hide a
+// fault.
+bool Optimizer::removeRedundantMoves(std::vector<Instruction>& code) {
+    std::vector<Instruction> out;
+    out.reserve(code.size());
+    bool changed = false;
+
+    for (auto& ins : code) {
+        bool isMove = ins.type == InstructionType::MOV && isDataReg(ins.operands[0]);
+        if (isMove) {
+            const Operand& dst = ins.operands[0];
+            const Operand& src = ins.operands[1];
+            if (isPlainReg(src, dst.regIndex)) {
+                hit("mov-self", ins);
+                changed = true;
+                continue;
+            }
+
+            Instruction* prev = out.empty() ? nullptr : &out.back();
+            if (prev && prev->type == InstructionType::MOV && isDataReg(prev->operands[0])) {
+                const Operand& prevDst = prev->operands[0];
+                const Operand& prevSrc = prev->operands[1];
+                if (isPlainReg(src) && isPlainReg(prevSrc, dst.regIndex) && prevDst.regIndex == src.regIndex) {
+                    hit("mov-reverse", ins);
+                    changed = true;
+                    continue;
+                }
+                if (prevDst.regIndex == dst.regIndex && !prevSrc.isMemory && !readsRegister(src, dst.regIndex)) {
+                    hit("mov-overwritten", *prev);
+                    *prev = std::move(ins);
+                    changed = true;
+                    continue;
+                }
+            }
+        }
+        out.push_back(std::move(ins));
+    }
+
+    code.swap(out);
+    return changed;
+}
+
+// Jumps to labels defined in this object:
+//   JMP/Jcc L, where L: is followed by JMP M   =>  JMP/Jcc M
+//   JMP/Jcc L, where L: is the next thing      =>  (nothing)
+// A jump never touches the flags, so the conditional ones fall out the same.
+bool Optimizer::threadJumps(std::vector<Instruction>& code) {
+    // Label ID to the index of the first instruction after it and any labels
+    // that follow it directly
+    std::unordered_map<int32_t, size_t> landing;
+    for (size_t i = 0; i < code.size(); i++) {
+        if (!isLabelDef(code[i])) continue;
+        size_t j = i;
+        while (j < code.size() && isLabelDef(code[j])) j++;
+        landing[code[i].labelId] = j;
+    }
+
+    bool changed = false;
+    for (size_t i = 0; i < code.size(); i++) {
+        Instruction& ins = code[i];
+        if (!isJump(ins.type) || !isDirectTarget(ins.operands[0])) continue;
+
+        // Follow the chain, a cycle of JMPs stops it after visiting every label
+        Operand& target = ins.operands[0];
+        int32_t original = target.labelId;
+        for (size_t steps = 0; steps < landing.size(); steps++) {
+            auto it = landing.find(target.labelId);
+            if (it == landing.end() || it->second >= code.size() || it->second == i) break;
+            const Instruction& next = code[it->second];
+            if (next.type != InstructionType::JMP || !isDirectTarget(next.operands[0]) ||
+                next.operands[0].labelId == target.labelId) {
+                break;
+            }
+            target.labelId = next.operands[0].labelId;
+        }
+        if (target.labelId != original) {
+            hit("jump-chain", ins);
+            changed = true;
+        }
+    }
+
+    std::vector<Instruction> out;
+    out.reserve(code.size());
+    for (size_t i = 0; i < code.size(); i++) {
+        const Instruction& ins = code[i];
+        if (isJump(ins.type) && isDirectTarget(ins.operands[0])) {
+            bool landsNext = false;
+            for (size_t j = i + 1; j < code.size() && isLabelDef(code[j]); j++) {
+                landsNext = landsNext || code[j].labelId == ins.operands[0].labelId;
+            }
+            if (landsNext) {
+                hit("jump-next", ins);
+                changed = true;
+                continue;
+            }
+        }
+        out.push_back(std::move(code[i]));
+    }
+
+    code.swap(out);
+    return changed;
+}
+
+// Blocks no entry reaches are dropped, apart from their label definitions
+bool Optimizer::removeUnreachableBlocks(std::vector<Instruction>& code) {
+    ControlFlowGraph cfg(code, internalLabels_);
+    std::vector<bool> reachable = cfg.reachable();
+
+    std::vector<bool> dead(code.size(), false);
+    bool changed = false;
+    for (size_t b = 0; b < cfg.getBlocks().size(); b++) {
+        const BasicBlock& block = cfg.getBlocks()[b];
+        if (reachable[b]) continue;
+        bool removed = false;
+        for (size_t i = block.begin; i < block.end; i++) {
+            if (!isLabelDef(code[i])) {
+                dead[i] = true;
+                removed = true;
+            }
+        }
+        if (removed) {
+            hit("unreachable-block", code[block.begin]);
+            changed = true;
+        }
+    }
+    if (changed) {
+        removeMarked(code, dead);
+    }
+    return changed;
+}
+
+namespace {
+
+// R14 and R15 move with PUSH, CALL and every jump, so they are never tracked
+constexpr int32_t TRACKED_REGISTERS = 14;
+
+// What is known about a register's value at some point on every path there
+struct RegisterValue {
+    enum Kind : uint8_t { UNSEEN, CONSTANT, COPY, UNKNOWN };
+    Kind kind = UNSEEN;
+    int64_t value = 0;  // the constant, or the register holding the same value
+
+    bool operator==(const RegisterValue& other) const {
+        bool hasValue = kind == CONSTANT || kind == COPY;
+        return kind == other.kind && (!hasValue || value == other.value);
+    }
+    bool operator!=(const RegisterValue& other) const {
+        return !(*this == other);
+    }
+};
+
+using RegisterState = std::array<RegisterValue, TRACKED_REGISTERS>;
+
+RegisterState unknownState() {
+    RegisterState state;
+    for (auto& v : state) v.kind = RegisterValue::UNKNOWN;
+    return state;
+}
+
+void meet(RegisterState& into, const RegisterState& from) {
+    for (int32_t r = 0; r < TRACKED_REGISTERS; r++) {
+        if (into[r].kind == RegisterValue::UNSEEN) into[r] = from[r];
+        else if (from[r].kind != RegisterValue::UNSEEN && into[r] != from[r]) into[r].kind = RegisterValue::UNKNOWN;
+    }
+}
+
+bool isTracked(const Operand& op) {
+    return isPlainReg(op) && op.regIndex < TRACKED_REGISTERS;
+}
+
+// The register's value as a constant or the register it copies, else itself
+RegisterValue canonical(const RegisterState& state, int32_t reg) {
+    if (reg < TRACKED_REGISTERS && (state[reg].kind == RegisterValue::CONSTANT || state[reg].kind == RegisterValue::COPY)) {
+        return state[reg];
+    }
+    return { RegisterValue::COPY, reg };
+}
+
+// What a MOV source puts in the destination, UNKNOWN if nothing useful
+RegisterValue moveSource(const RegisterState& state, const Operand& src) {
+    if (isImm(src)) return { RegisterValue::CONSTANT, src.immediate };
+    if (isTracked(src)) return canonical(state, src.regIndex);
+    return { RegisterValue::UNKNOWN, 0 };
+}
+
+void transfer(RegisterState& state, const Instruction& ins) {
+    if (ins.type == InstructionType::MOV && isPlainReg(ins.operands[1], ins.operands[0].regIndex)) {
+        return;
+    }
+    RegisterSet defs = instructionEffects(ins).defs;
+    for (int32_t r = 0; r < TRACKED_REGISTERS; r++) {
+        if (!(defs & (RegisterSet(1) << r))) continue;
+        state[r].kind = RegisterValue::UNKNOWN;
+        for (auto& v : state) {
+            if (v.kind == RegisterValue::COPY && v.value == r) v.kind = RegisterValue::UNKNOWN;
+        }
+    }
+    if (ins.type == InstructionType::MOV && isTracked(ins.operands[0])) {
+        // canonical() never answers with the destination, it was just cleared
+        RegisterValue source = moveSource(state, ins.operands[1]);
+        if (source.kind != RegisterValue::UNKNOWN && !(source.kind == RegisterValue::COPY && source.value == ins.operands[0].regIndex)) {
+            state[ins.operands[0].regIndex] = source;
+        }
+    }
+}
+
+} // namespace
+
+// Forward dataflow over the graph: which registers hold a known constant or
+// a copy of another register on every path. With that, reads are redirected
+// to the original register or replaced by the constant where the operand can
+// be an immediate, and MOVs that store what the register already holds go.
+// The copies left behind usually die, see removeDeadStores. Values are not
+// followed through memory, and entries start with nothing known.
+bool Optimizer::propagateValues(std::vector<Instruction>& code) {
+    ControlFlowGraph cfg(code, internalLabels_);
+    const std::vector<BasicBlock>& blocks = cfg.getBlocks();
+
+    std::vector<RegisterState> in(blocks.size());
+    std::vector<RegisterState> out(blocks.size());
+    std::vector<bool> visited(blocks.size(), false);
+
+    // Blocks whose input may have changed, in order
+    std::deque<size_t> work;
+    std::vector<bool> queued(blocks.size(), true);
+    for (size_t b = 0; b < blocks.size(); b++) {
+        work.push_back(b);
+    }
+    while (!work.empty()) {
+        size_t b = work.front();
+        work.pop_front();
+        queued[b] = false;
+
+        RegisterState state;
+        bool seen = blocks[b].isEntry;
+        if (seen) state = unknownState();
+        for (size_t p : blocks[b].predecessors) {
+            if (visited[p]) {
+                meet(state, out[p]);
+                seen = true;
+            }
+        }
+        if (!seen) continue;
+        in[b] = state;
+        for (size_t i = blocks[b].begin; i < blocks[b].end; i++) {
+            transfer(state, code[i]);
+        }
+        // A register's value may go from a constant to a copy and back around
+        // a loop, so facts only ever get dropped: that keeps the loop finite
+        if (visited[b]) {
+            meet(state, out[b]);
+        }
+        if (!visited[b] || state != out[b]) {
+            out[b] = state;
+            visited[b] = true;
+            for (size_t s : blocks[b].successors) {
+                if (!queued[s]) {
+                    queued[s] = true;
+                    work.push_back(s);
+                }
+            }
+        }
+    }
+
+    std::vector<bool> dead(code.size(), false);
+    bool rewritten = false;
+    for (size_t b = 0; b < blocks.size(); b++) {
+        if (!visited[b]) continue;
+        RegisterState state = in[b];
+
+        auto substitute = [&](Operand& op, bool immediateOk, const Instruction& at) {
+            if (op.isMemory) {
+                // Only the address registers, a constant would change the operand's form
+                for (int32_t* reg : { op.isRegister && !op.isVector ? &op.regIndex : nullptr, &op.indexReg }) {
+                    if (!reg || *reg < 0 || *reg >= TRACKED_REGISTERS) continue;
+                    RegisterValue v = canonical(state, *reg);
+                    if (v.kind == RegisterValue::COPY && v.value != *reg) {
+                        *reg = static_cast<int32_t>(v.value);
+                        hit("copy-propagation", at);
+                        rewritten = true;
+                    }
+                }
+                return;
+            }
+            if (!isTracked(op)) return;
+            RegisterValue v = canonical(state, op.regIndex);
+            if (v.kind == RegisterValue::COPY && v.value != op.regIndex) {
+                op.regIndex = static_cast<int32_t>(v.value);
+                hit("copy-propagation", at);
+                rewritten = true;
+            }
+            else if (v.kind == RegisterValue::CONSTANT && immediateOk) {
+                op = makeImmOperand(v.value, at);
+                hit("constant-propagation", at);
+                rewritten = true;
+            }
+        };
+
+        for (size_t i = blocks[b].begin; i < blocks[b].end; i++) {
+            Instruction& ins = code[i];
+            std::vector<Operand>& ops = ins.operands;
+            switch (ins.type) {
+            case InstructionType::MOV:
+                if (isTracked(ops[0])) {
+                    RegisterValue source = moveSource(state, ops[1]);
+                    if (source.kind != RegisterValue::UNKNOWN && canonical(state, ops[0].regIndex) == source) {
+                        hit("redundant-move", ins);
+                        dead[i] = true;
+                        rewritten = true;
+                        continue;
+                    }
+                }
+                substitute(ops[1], true, ins);
+                if (ops[0].isMemory) substitute(ops[0], false, ins);
+                break;
+            case InstructionType::ADD: case InstructionType::SUB:
+            case InstructionType::MUL: case InstructionType::DIV:
+                substitute(ops[1], true, ins);
+                substitute(ops[2], true, ins);
+                if (ops[0].isMemory) substitute(ops[0], false, ins);
+                break;
+            case InstructionType::AND: case InstructionType::OR: case InstructionType::XOR:
+            case InstructionType::SHL: case InstructionType::SHR:
+                substitute(ops[1], true, ins);
+                break;
+            case InstructionType::CMP:
+                substitute(ops[0], false, ins);
+                substitute(ops[1], true, ins);
+                break;
+            case InstructionType::CMOVE: case InstructionType::CMOVNE: case InstructionType::CMOVG:
+            case InstructionType::CMOVL: case InstructionType::CMOVLE: case InstructionType::CMOVGE:
+            case InstructionType::LOAD: case InstructionType::ALLOC:
+            case InstructionType::VLOAD: case InstructionType::VSPLAT:
+                substitute(ops[1], false, ins);
+                break;
+            case InstructionType::STORE:
+                substitute(ops[0], false, ins);
+                substitute(ops[1], false, ins);
+                break;
+            case InstructionType::PUSH: case InstructionType::FREE: case InstructionType::VSTORE:
+            case InstructionType::JMP: case InstructionType::JE: case InstructionType::JNE:
+            case InstructionType::JG: case InstructionType::JL: case InstructionType::JLE:
+            case InstructionType::JGE:
+                substitute(ops[0], false, ins);
+                break;
+            default:
+                break;
+            }
+            transfer(state, ins);
+        }
+    }
+
+    if (rewritten) {
+        removeMarked(code, dead);
+    }
+    return rewritten;
+}
+
+// Instructions whose only effect is a register nobody reads before it is
+// written again. Anything touching memory or the flags stays, as does a DIV
+// that could divide by zero and any write to R14 or R15.
+bool Optimizer::removeDeadStores(std::vector<Instruction>& code) {
+    ControlFlowGraph cfg(code, internalLabels_);
+    cfg.computeLiveness();
+
+    std::vector<bool> dead(code.size(), false);
+    bool changed = false;
+    for (const BasicBlock& block : cfg.getBlocks()) {
+        RegisterSet live = block.liveOut;
+        for (size_t i = block.end; i-- > block.begin;) {
+            const Instruction& ins = code[i];
+            InstructionEffects effects = instructionEffects(ins);
+
+            bool removable = false;
+            switch (ins.type) {
+            case InstructionType::MOV: case InstructionType::ADD: case InstructionType::SUB:
+            case InstructionType::MUL: case InstructionType::AND: case InstructionType::OR:
+            case InstructionType::XOR: case InstructionType::SHL: case InstructionType::SHR:
+            case InstructionType::CMOVE: case InstructionType::CMOVNE: case InstructionType::CMOVG:
+            case InstructionType::CMOVL: case InstructionType::CMOVLE: case InstructionType::CMOVGE:
+            case InstructionType::SETE: case InstructionType::SETNE: case InstructionType::SETG:
+            case InstructionType::SETL: case InstructionType::SETLE: case InstructionType::SETGE:
+                removable = true;
+                break;
+            case InstructionType::DIV:
+                removable = isImm(ins.operands[2]) && ins.operands[2].immediate != 0;
+                break;
+            default:
+                break;
+            }
+            removable = removable && effects.defs != 0 && (effects.defs & 0xC000) == 0 &&
+                !effects.readsMemory && !effects.writesMemory && !effects.writesFlags;
+
+            if (removable && (effects.defs & live) == 0) {
+                hit("dead-store", ins);
+                dead[i] = true;
+                changed = true;
+                continue;
+            }
+            live = (live & ~effects.defs) | effects.uses;
+        }
+    }
+
+    if (changed) {
+        removeMarked(code, dead);
+    }
+    return changed;
+}
+
+// Natural loops, innermost first, get a preheader: code inserted right before
+// the header that runs once on the way in. When the header is an entry its
+// labels move onto the preheader, since another object may call them, and
+// jumps from inside the loop take a new label on the header. Otherwise jumps
+// from outside the loop take a new label on the preheader. A loop that falls
+// into its header from inside is left alone. Two rewrites fill the preheader:
+//
+// loop-invariant: MOV/ADD/SUB/MUL d, ... whose sources are constants or
+// registers the loop never writes, where d is written nowhere else in the
+// loop and not read before this on the way in, and the instruction runs before
+// every exit. Hoisting one can make others invariant.
+//
+// induction-variable: MUL d, a, i where a is invariant and i changes by a
+// constant c once per pass, in the same block as the MUL (ADD/SUB i, i, c or
+// LOOP i). d then tracks a*i with an ADD or SUB of a*c per pass instead:
+//
+//       mul d, a, i                    mul d, a, i
+//   top:                               add d, d, a       (minus one step)
+//       mul d, a, i       =>       top:
+//       ...                            sub d, d, a
+//       loop i, top                    ...
+//                                      loop i, top
+//
+// The step is a register when c is 1 or -1, otherwise a must be a constant.
+// The block must run before every exit and on every pass, so d still holds
+// a*i from the last pass when the loop is left. Other loops that overlap one
+// already rewritten wait for the next pass.
+bool Optimizer::optimizeLoops(std::vector<Instruction>& code, LabelTable& labels) {
+    ControlFlowGraph cfg(code, internalLabels_);
+    cfg.computeLiveness();
+    const std::vector<BasicBlock>& blocks = cfg.getBlocks();
+    std::vector<Loop> loops = cfg.findLoops();
+    if (loops.empty()) return false;
+
+    std::vector<size_t> blockOf(code.size());
+    for (size_t b = 0; b < blocks.size(); b++) {
+        for (size_t i = blocks[b].begin; i < blocks[b].end; i++) blockOf[i] = b;
+    }
+
+    // Direct jump and LOOP targets, label ID to (instruction, operand)
+    std::unordered_map<int32_t, std::vector<std::pair<size_t, size_t>>> jumpsTo;
+    for (size_t i = 0; i < code.size(); i++) {
+        size_t k = code[i].type == InstructionType::LOOP ? 1 : 0;
+        if ((isJump(code[i].type) || code[i].type == InstructionType::LOOP) && isDirectTarget(code[i].operands[k])) {
+            jumpsTo[code[i].operands[k].labelId].push_back({ i, k });
+        }
+    }
+
+    std::vector<std::vector<Instruction>> insertBefore(code.size());
+    std::vector<bool> moved(code.size(), false);
+    std::vector<bool> touched(blocks.size(), false);
+    bool changed = false;
+
+    for (const Loop& loop : loops) {
+        const BasicBlock& header = blocks[loop.header];
+        auto inLoop = [&](size_t b) { return std::binary_search(loop.blocks.begin(), loop.blocks.end(), b); };
+
+        size_t first = header.begin;    // the header's first instruction after its labels
+        while (first < header.end && isLabelDef(code[first])) first++;
+        if (first == header.begin || first == header.end) continue;
+        if (loop.header > 0 && blocks[loop.header - 1].fallsThrough && inLoop(loop.header - 1)) continue;
+        bool overlaps = false;
+        for (size_t b : loop.blocks) overlaps = overlaps || touched[b];
+        if (overlaps) continue;
+
+        std::vector<size_t> exiting;
+        std::array<int32_t, 16> defCount{};
+        for (size_t b : loop.blocks) {
+            bool leaves = blocks[b].exits;
+            for (size_t s : blocks[b].successors) leaves = leaves || !inLoop(s);
+            if (leaves) exiting.push_back(b);
+            for (size_t i = blocks[b].begin; i < blocks[b].end; i++) {
+                RegisterSet defs = instructionEffects(code[i]).defs;
+                for (int32_t r = 0; r < 16; r++) {
+                    if (defs & (RegisterSet(1) << r)) defCount[r]++;
+                }
+            }
+        }
+        auto dominatesAll = [&](size_t b, const std::vector<size_t>& targets) {
+            for (size_t t : targets) {
+                if (!cfg.dominates(b, t)) return false;
+            }
+            return true;
+        };
+        auto isInvariant = [&](const Operand& op) {
+            return isImm(op) || (isTracked(op) && defCount[op.regIndex] == 0) ||
+                (op.isLabel && !op.isMemory && op.indexReg == -1);
+        };
+        // The loop's only write to d, and nothing in the loop reads d first
+        auto ownsDestination = [&](const Instruction& ins) {
+            if (ins.operands.empty() || !isTracked(ins.operands[0])) return false;
+            int32_t d = ins.operands[0].regIndex;
+            return defCount[d] == 1 && !(header.liveIn & (RegisterSet(1) << d));
+        };
+
+        std::vector<Instruction> preheader;
+
+        bool hoisted = true;
+        while (hoisted) {
+            hoisted = false;
+            for (size_t b : loop.blocks) {
+                if (!dominatesAll(b, exiting)) continue;
+                for (size_t i = blocks[b].begin; i < blocks[b].end; i++) {
+                    const Instruction& ins = code[i];
+                    if (moved[i] || !ownsDestination(ins)) continue;
+                    bool candidate = false;
+                    switch (ins.type) {
+                    case InstructionType::MOV:
+                        candidate = isInvariant(ins.operands[1]);
+                        break;
+                    case InstructionType::ADD: case InstructionType::SUB: case InstructionType::MUL:
+                        candidate = isInvariant(ins.operands[1]) && isInvariant(ins.operands[2]);
+                        break;
+                    default:
+                        break;
+                    }
+                    if (!candidate) continue;
+
+                    preheader.push_back(ins);
+                    moved[i] = true;
+                    defCount[ins.operands[0].regIndex] = 0;
+                    hit("loop-invariant", ins);
+                    hoisted = true;
+                }
+            }
+        }
+
+        for (size_t b : loop.blocks) {
+            if (!dominatesAll(b, exiting) || !dominatesAll(b, loop.latches)) continue;
+            for (size_t i = blocks[b].begin; i < blocks[b].end; i++) {
+                Instruction& ins = code[i];
+                if (ins.type != InstructionType::MUL || moved[i] || !ownsDestination(ins)) continue;
+                int32_t d = ins.operands[0].regIndex;
+
+                for (size_t k = 1; k <= 2; k++) {
+                    const Operand& iv = ins.operands[k];
+                    const Operand& a = ins.operands[3 - k];
+                    if (!isTracked(iv) || iv.regIndex == d || defCount[iv.regIndex] != 1 || !isInvariant(a) || a.isLabel) {
+                        continue;
+                    }
+
+                    // The induction variable's update, in this block
+                    size_t update = blocks[b].end;
+                    int64_t c = 0;
+                    for (size_t u = blocks[b].begin; u < blocks[b].end; u++) {
+                        const Instruction& up = code[u];
+                        if (!(instructionEffects(up).defs & (RegisterSet(1) << iv.regIndex))) continue;
+                        if ((up.type == InstructionType::ADD || up.type == InstructionType::SUB) &&
+                            isPlainReg(up.operands[1], iv.regIndex) && isImm(up.operands[2])) {
+                            update = u;
+                            c = up.type == InstructionType::ADD ? up.operands[2].immediate : -up.operands[2].immediate;
+                        }
+                        else if (up.type == InstructionType::LOOP) {
+                            update = u;
+                            c = -1;
+                        }
+                    }
+                    if (update == blocks[b].end || c == 0) continue;
+
+                    // d changes by a*c per pass
+                    InstructionType stepType = InstructionType::ADD;
+                    Operand step = a;
+                    if (isImm(a)) {
+                        int64_t s = a.immediate * c;
+                        if (a.immediate < INT32_MIN || a.immediate > INT32_MAX || s < INT32_MIN || s > INT32_MAX) continue;
+                        step = makeImmOperand(s, ins);
+                    }
+                    else if (c == -1) {
+                        stepType = InstructionType::SUB;
+                    }
+                    else if (c != 1) {
+                        continue;
+                    }
+                    InstructionType undoType = stepType == InstructionType::ADD ? InstructionType::SUB : InstructionType::ADD;
+
+                    hit("induction-variable", ins);
+                    preheader.push_back(ins);
+                    if (update > i) {
+                        preheader.push_back(makeInstruction(undoType, ins, ins.operands[0], ins.operands[0], step));
+                    }
+                    ins = makeInstruction(stepType, ins, ins.operands[0], ins.operands[0], step);
+                    break;
+                }
+            }
+        }
+
+        if (preheader.empty()) continue;
+
+        // Entries from outside the loop go through the preheader
+        bool entry = header.isEntry;
+        std::vector<std::pair<size_t, size_t>> retarget;
+        for (size_t i = header.begin; i < first; i++) {
+            auto it = jumpsTo.find(code[i].labelId);
+            if (it == jumpsTo.end()) continue;
+            for (const auto& ref : it->second) {
+                if (inLoop(blockOf[ref.first]) == entry) retarget.push_back(ref);
+            }
+        }
+        std::vector<Instruction>& inserted = insertBefore[header.begin];
+        if (entry) {
+            for (size_t i = header.begin; i < first; i++) {
+                inserted.push_back(code[i]);
+                moved[i] = true;
+            }
+        }
+        if (!retarget.empty()) {
+            const Instruction& at = code[header.begin];
+            int32_t label = makeInternalLabel(labels, labels.name(at.labelId) + (entry ? ".TOP" : ".PRE"));
+            (entry ? insertBefore[first] : inserted).push_back(makeLabel(label, at));
+            for (const auto& [i, k] : retarget) {
+                code[i].operands[k].labelId = label;
+            }
+        }
+        inserted.insert(inserted.end(), preheader.begin(), preheader.end());
+
+        for (size_t b : loop.blocks) touched[b] = true;
+        changed = true;
+    }
+
+    if (!changed) return false;
+
+    std::vector<Instruction> out;
+    out.reserve(code.size());
+    for (size_t i = 0; i < code.size(); i++) {
+        for (auto& ins : insertBefore[i]) out.push_back(std::move(ins));
+        if (!moved[i]) out.push_back(std::move(code[i]));
+    }
+    code.swap(out);
+    return true;
+}
+
+int32_t Optimizer::makeInternalLabel(LabelTable& labels, const std::string& base) {
+    std::string name = base;
+    for (int32_t n = 2; labels.find(name) != -1; n++) {
+        name = base + std::to_string(n);
+    }
+    int32_t id = labels.intern(name);
+    if (static_cast<size_t>(id) >= internalLabels_.size()) {
+        internalLabels_.resize(id + 1, false);
+    }
+    internalLabels_[id] = true;
+    return id;
+}
+
+void Optimizer::removeMarked(std::vector<Instruction>& code, const std::vector<bool>& marked) {
+    size_t kept = 0;
+    for (size_t i = 0; i < code.size(); i++) {
+        if (!marked[i]) {
+            if (kept != i) code[kept] = std::move(code[i]);
+            kept++;
+        }
+    }
+    code.resize(kept);
+}
+
+void Optimizer::hit(const std::string& rule, const Instruction& at) {
+    stats_[rule]++;
+    debugPrint("Applied " + rule + " at line " + std::to_string(at.line));
+}
+
+const std::map<std::string, int32_t>& Optimizer::getStats() const {
+    return stats_;
+}
+
+void Optimizer::printStats(std::ostream& out) const {
+    out << "Optimizer rule hits:\n";
+    if (stats_.empty()) {
+        out << "  (none)\n";
+    }
+    for (const auto& [rule, count] : stats_) {
+        out << "  " << rule << ": " << count << "\n";
+    }
+}
+
+void Optimizer::debugPrint(const std::string& message) const {
+    if (debug_) {
+        std::cout << "[Optimizer Debug] " << message << "\n";
+    }
+}
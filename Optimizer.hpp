@@ -0,0 +1,61 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#pragma once
+
+#include "Parser.hpp"
+#include "ControlFlow.hpp"
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <iostream>
+
+// Optional rewrite passes over the parsed instruction list, run by the
+// Compiler before emission. Every rewrite preserves memory, the flags and
+// every register that can still be read, wherever control can enter or leave
+// the object (see ControlFlowGraph for which labels count as entries).
+class Optimizer {
+public:
+    Optimizer(bool debug = false)
+        : debug_(debug) {
+    }
+
+    // Part of the object cache key for -O builds: bump it whenever a rule is
+    // added or changes what it emits
+    static constexpr int32_t VERSION = 4;
+
+    // Labels the rewrites introduce are interned into labels
+    std::vector<Instruction> optimize(const std::vector<Instruction>& instructions, LabelTable& labels);
+
+    // Number of times each rule fired
+    const std::map<std::string, int32_t>& getStats() const;
+    void printStats(std::ostream& out = std::cout) const;
+
+private:
+    void rewriteCountedLoops(std::vector<Instruction>& code, LabelTable& labels);
+
+    // Peephole rules, each returns whether it changed anything
+    bool simplifyArithmetic(std::vector<Instruction>& code);
+    bool removeRedundantMoves(std::vector<Instruction>& code);
+    bool threadJumps(std::vector<Instruction>& code);
+
+    // Passes over the control flow graph
+    bool removeUnreachableBlocks(std::vector<Instruction>& code);
+    bool propagateValues(std::vector<Instruction>& code);
+    bool removeDeadStores(std::vector<Instruction>& code);
+    bool optimizeLoops(std::vector<Instruction>& code, LabelTable& labels);
+
+    // Interns a new label named after base, which only the optimizer uses
+    int32_t makeInternalLabel(LabelTable& labels, const std::string& base);
+
+    static void removeMarked(std::vector<Instruction>& code, const std::vector<bool>& marked);
+
+    static constexpr int32_t MAX_PASSES = 8;
+
+    void hit(const std::string& rule, const Instruction& at);
+    void debugPrint(const std::string& message) const;
+
+    std::map<std::string, int32_t> stats_;
+    std::vector<bool> internalLabels_;  // label ID to whether makeInternalLabel made it
+    bool debug_;
+};
@@ -1,10 +1,21 @@
 // Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
 
 #include "Parser.hpp"
+#include "ThreadPool.hpp"
+#include "ModuleCache.hpp"
+#include "SourceFile.hpp"
+#include "Utility.hpp"
 #include <iostream>
+#include <filesystem>
+#include <cctype>
+#include <algorithm>
 
 std::string tokenTypeName(TokenType t);
 
+static bool isVectorRegister(const Token& t) {
+    return t.text[0] == 'V' || t.text[0] == 'v';
+}
+
 Parser::Parser(const std::vector<std::string>& lines, bool debug) : debug_(debug)
 {
     for (size_t i = 0; i < lines.size(); i++) {
@@ -26,6 +37,324 @@ Parser::Parser(const std::vector<std::string>& lines, bool debug) : debug_(debug
     }
 }
 
+Parser::Parser(std::string_view source, bool debug) : debug_(debug)
+{
+    parseSource(source);
+}
+
+Parser::Parser(std::string_view source, InstructionHandler onInstruction, bool debug, ModuleCache* modules, const std::string& directory)
+    : onInstruction_(std::move(onInstruction)), modules_(modules), directory_(directory), debug_(debug)
+{
+    parseSource(source);
+}
+
+void Parser::parseSource(std::string_view source, int32_t firstLine)
+{
+    if (debug_)
+    {
+        Lexer debugLexer(source, firstLine);
+        do {
+            std::cout << "Line " << debugLexer.currentToken().line << " tokens:\n";
+            while (!debugLexer.ended()) {
+                Token tk = debugLexer.currentToken();
+                std::cout << "  " << tokenTypeName(tk.type) << " \"" << tk.text << "\" (line " << tk.line << ", col " << tk.col << ")\n";
+                debugLexer.nextToken();
+            }
+        } while (debugLexer.nextLine());
+    }
+
+    Lexer lexer(source, firstLine);
+    do {
+        parseLine(lexer);
+    } while (lexer.nextLine());
+}
+
+// Chunks are at least this big, and each thread gets a few of them to even out
+// chunks that parse slower than others
+static constexpr size_t MIN_CHUNK_BYTES = 64 * 1024;
+static constexpr size_t CHUNKS_PER_THREAD = 4;
+
+static size_t chunkSize(size_t sourceBytes, const ThreadPool& pool) {
+    return std::max(MIN_CHUNK_BYTES, sourceBytes / (pool.size() * CHUNKS_PER_THREAD) + 1);
+}
+
+bool Parser::parsesInChunks(size_t sourceBytes, const ThreadPool& pool) {
+    return pool.size() > 1 && sourceBytes >= 2 * chunkSize(sourceBytes, pool);
+}
+
+namespace {
+
+struct ChunkStart {
+    size_t offset;
+    int32_t line;
+    Section section;
+    int32_t bits;
+};
+
+// Splits at line starts and tracks .data/.code/.bits on the way, so each chunk
+// knows the section and mode it starts in. Only lines that start with a
+// directive are looked at; malformed ones are left for the chunk's parser.
+std::vector<ChunkStart> splitChunks(std::string_view source, size_t chunkBytes) {
+    std::vector<ChunkStart> starts;
+    Section section = Section::CODE;
+    int32_t bits = 32;
+    int32_t line = 1;
+    size_t pos = 0;
+    size_t nextStart = 0;
+
+    while (pos < source.size()) {
+        if (pos >= nextStart) {
+            starts.push_back({ pos, line, section, bits });
+            nextStart = pos + chunkBytes;
+        }
+
+        size_t eol = source.find('\n', pos);
+        if (eol == std::string_view::npos) eol = source.size();
+
+        size_t p = pos;
+        while (p < eol && (source[p] == ' ' || source[p] == '\t' || source[p] == '\r')) p++;
+        if (p < eol && source[p] == '.') {
+            size_t q = ++p;
+            while (q < eol && std::isalpha(static_cast<uint8_t>(source[q]))) q++;
+            const Keyword* keyword = findKeyword(source.substr(p, q - p));
+            if (keyword && keyword->kind == KeywordKind::DIRECTIVE) {
+                if (keyword->name == "DATA") section = Section::DATA;
+                else if (keyword->name == "CODE") section = Section::CODE;
+                else if (keyword->name == "BITS") {
+                    while (q < eol && (source[q] == ' ' || source[q] == '\t')) q++;
+                    if (source.substr(q, 2) == "64") bits = 64;
+                    else if (source.substr(q, 2) == "32") bits = 32;
+                }
+            }
+        }
+
+        pos = eol + 1;
+        line++;
+    }
+    if (starts.empty()) {
+        starts.push_back({ 0, 1, Section::CODE, 32 });
+    }
+    return starts;
+}
+
+} // namespace
+
+Parser::Parser(std::string_view source, ThreadPool& pool, bool debug, ModuleCache* modules, const std::string& directory)
+    : modules_(modules), directory_(directory), debug_(debug)
+{
+    if (debug_ || !parsesInChunks(source.size(), pool)) {
+        parseSource(source);
+        return;
+    }
+
+    std::vector<ChunkStart> starts = splitChunks(source, chunkSize(source.size(), pool));
+    auto chunkText = [&](size_t k) {
+        size_t end = k + 1 < starts.size() ? starts[k + 1].offset : source.size();
+        return source.substr(starts[k].offset, end - starts[k].offset);
+    };
+
+    std::vector<std::unique_ptr<Parser>> chunks(starts.size());
+    std::vector<std::exception_ptr> errors(starts.size());
+    pool.run(starts.size(), [&](size_t k) {
+        try {
+            chunks[k].reset(new Parser(*this, starts[k].section, starts[k].bits));
+            chunks[k]->parseSource(chunkText(k), starts[k].line);
+        }
+        catch (...) {
+            errors[k] = std::current_exception();
+        }
+        });
+
+    // The pre-scan cannot see into included files, which may switch section or
+    // mode. A chunk that started in the wrong state is parsed again, in order.
+    Section section = Section::CODE;
+    int32_t bits = 32;
+    for (size_t k = 0; k < chunks.size(); k++) {
+        if (starts[k].section != section || starts[k].bits != bits) {
+            errors[k] = nullptr;
+            chunks[k].reset(new Parser(*this, section, bits));
+            chunks[k]->parseSource(chunkText(k), starts[k].line);
+        }
+        if (errors[k]) {
+            std::rethrow_exception(errors[k]);
+        }
+        section = chunks[k]->currentSection_;
+        bits = chunks[k]->bits_;
+    }
+
+    mergeChunks(chunks, pool);
+}
+
+Parser::Parser(const Parser& parent, Section section, int32_t bits)
+    : currentSection_(section), bits_(bits),
+    modules_(parent.modules_), directory_(parent.directory_), includeStack_(parent.includeStack_)
+{
+}
+
+static void remapLabels(Instruction& ins, const std::vector<int32_t>& map) {
+    if (ins.labelId != -1) ins.labelId = map[ins.labelId];
+    for (auto& op : ins.operands) {
+        if (op.isLabel) op.labelId = map[op.labelId];
+    }
+}
+
+// IDs in this parser's table for each of part's labels
+std::vector<int32_t> Parser::internLabels(const Parser& part) {
+    std::vector<int32_t> map;
+    map.reserve(part.labels_.size());
+    for (const auto& name : part.labels_.names()) {
+        map.push_back(labels_.intern(name));
+    }
+    return map;
+}
+
+// Data labels and relocations of part, rebased to start at offsetBase
+void Parser::appendDataSymbols(const Parser& part, const std::vector<int32_t>& map, int32_t offsetBase) {
+    for (const auto& [labelId, offset] : part.dataLabels_) {
+        dataLabels_[map[labelId]] = offsetBase + offset;
+    }
+    for (const auto& reloc : part.dataRelocs_) {
+        dataRelocs_.push_back({ offsetBase + reloc.offset, map[reloc.labelId] });
+    }
+}
+
+// Appends the chunks in source order: label IDs are mapped into this parser's
+// table (interning in chunk order gives the same IDs a sequential parse would),
+// and data offsets are rebased past the data of the chunks before.
+void Parser::mergeChunks(std::vector<std::unique_ptr<Parser>>& chunks, ThreadPool& pool) {
+    std::vector<std::vector<int32_t>> labelMaps(chunks.size());
+    std::vector<size_t> instructionBase(chunks.size());
+    std::vector<size_t> wordBase(chunks.size());
+    std::vector<int32_t> offsetBase(chunks.size());
+
+    size_t instructionCount = 0;
+    size_t wordCount = 0;
+    bool emitted = false;
+    for (size_t k = 0; k < chunks.size(); k++) {
+        const Parser& chunk = *chunks[k];
+        if (chunk.bitsLine_ != 0 && emitted) {
+            error(".bits must come before any code or data", chunk.bitsLine_, chunk.bitsCol_);
+        }
+        emitted = emitted || !chunk.instructions_.empty() || !chunk.dataSegment_.empty() || !chunk.dataLabels_.empty();
+
+        labelMaps[k] = internLabels(chunk);
+        instructionBase[k] = instructionCount;
+        wordBase[k] = wordCount;
+        offsetBase[k] = dataOffset_;
+        instructionCount += chunk.instructions_.size();
+        wordCount += chunk.dataSegment_.size();
+        dataOffset_ += chunk.dataOffset_;
+    }
+
+    instructions_.resize(instructionCount);
+    dataSegment_.resize(wordCount);
+    pool.run(chunks.size(), [&](size_t k) {
+        Parser& chunk = *chunks[k];
+        for (size_t i = 0; i < chunk.instructions_.size(); i++) {
+            Instruction& ins = instructions_[instructionBase[k] + i];
+            ins = std::move(chunk.instructions_[i]);
+            remapLabels(ins, labelMaps[k]);
+        }
+        std::copy(chunk.dataSegment_.begin(), chunk.dataSegment_.end(), dataSegment_.begin() + wordBase[k]);
+        });
+
+    for (size_t k = 0; k < chunks.size(); k++) {
+        appendDataSymbols(*chunks[k], labelMaps[k], offsetBase[k]);
+    }
+
+    currentSection_ = chunks.back()->currentSection_;
+    bits_ = chunks.back()->bits_;
+}
+
+std::string Parser::resolveInclude(std::string_view name, const std::string& directory) {
+    std::filesystem::path path(name);
+    if (path.is_relative() && !directory.empty()) {
+        path = std::filesystem::path(directory) / path;
+    }
+    return std::filesystem::weakly_canonical(std::filesystem::absolute(path)).string();
+}
+
+// .include "file" parses the file as if its text stood in place of the line:
+// its code and data follow what came before, and the section and mode it ends
+// in carry on after it. Relative paths resolve against the including file's
+// directory.
+void Parser::includeFile(const Token& name) {
+    std::string resolved = resolveInclude(name.text, directory_);
+    if (std::find(includeStack_.begin(), includeStack_.end(), resolved) != includeStack_.end()) {
+        error(".include cycle through " + resolved, name.line, name.col);
+    }
+
+    std::shared_ptr<const Parser> module;
+    try {
+        module = loadModule(resolved);
+    }
+    catch (const std::exception& ex) {
+        error("In " + resolved + ": " + ex.what(), name.line, name.col);
+    }
+
+    if (module->bitsLine_ != 0) {
+        if (hasOutput()) {
+            error(".bits must come before any code or data", name.line, name.col);
+        }
+        if (bitsLine_ == 0) {
+            bitsLine_ = name.line;
+            bitsCol_ = name.col;
+        }
+    }
+
+    // The module's code was parsed in its mode, and a streaming compiler
+    // encodes each instruction with the mode current when it is handed over
+    bits_ = module->bits_;
+
+    std::vector<int32_t> map = internLabels(*module);
+    if (!onInstruction_) {
+        instructions_.reserve(instructions_.size() + module->instructions_.size());
+    }
+    for (const auto& moduleIns : module->instructions_) {
+        Instruction ins = moduleIns;
+        remapLabels(ins, map);
+        addInstruction(ins);
+    }
+    dataSegment_.insert(dataSegment_.end(), module->dataSegment_.begin(), module->dataSegment_.end());
+    appendDataSymbols(*module, map, dataOffset_);
+    dataOffset_ += module->dataOffset_;
+
+    currentSection_ = module->currentSection_;
+}
+
+// A module depends on its path (nested includes resolve against it), its
+// content and the section and mode it starts in
+std::shared_ptr<const Parser> Parser::loadModule(const std::string& path) {
+    SourceFile source(path);
+    std::string key = path + "|" + std::to_string(hashBytes(source.text())) + "|" +
+        std::to_string(static_cast<int32_t>(currentSection_)) + "|" + std::to_string(bits_);
+    if (modules_) {
+        if (std::shared_ptr<const Parser> module = modules_->find(key)) {
+            return module;
+        }
+    }
+
+    std::shared_ptr<Parser> module(new Parser(*this, currentSection_, bits_));
+    module->directory_ = std::filesystem::path(path).parent_path().string();
+    module->includeStack_.push_back(path);
+    module->parseSource(source.text());
+    return modules_ ? modules_->insert(key, module) : module;
+}
+
+void Parser::addInstruction(Instruction& ins) {
+    if (onInstruction_) {
+        onInstruction_(ins, bits_);
+        streamed_++;
+    }
+    else {
+        instructions_.push_back(std::move(ins));
+    }
+}
+
+bool Parser::hasOutput() const {
+    return !instructions_.empty() || streamed_ != 0 || !dataSegment_.empty() || !dataLabels_.empty();
+}
+
 const std::vector<Instruction>& Parser::getInstructions() const {
     return instructions_;
 }
@@ -34,11 +363,23 @@ const std::vector<int32_t>& Parser::getDataSegment() const {
     return dataSegment_;
 }
 
-const std::unordered_map<std::string, int32_t>& Parser::getDataLabels() const
+const std::unordered_map<int32_t, int32_t>& Parser::getDataLabels() const
 {
     return dataLabels_;
 }
 
+const LabelTable& Parser::getLabels() const {
+    return labels_;
+}
+
+const std::vector<DataReloc>& Parser::getDataRelocs() const {
+    return dataRelocs_;
+}
+
+int32_t Parser::getBits() const {
+    return bits_;
+}
+
 
 void Parser::parseLine(Lexer& lex) {
     if (lex.ended()) return;
@@ -48,9 +389,8 @@ void Parser::parseLine(Lexer& lex) {
         return; // empty line
     }
 
-    if (first.type == TokenType::T_DIRECTIVE) {
-        handleDirective(first);
-        lex.nextToken();
+    if (first.type == TokenType::T_DIRECTIVE && first.text != "WORD" && first.text != "DWORD" && first.text != "JUMPTABLE") {
+        handleDirective(lex);
         return;
     }
 
@@ -60,7 +400,7 @@ void Parser::parseLine(Lexer& lex) {
     }
 
     if (first.type == TokenType::T_LABEL) {
-        std::string labelName = first.text;
+        int32_t labelId = labels_.intern(first.text);
         int32_t lline = first.line;
         int32_t lcol = first.col;
         lex.nextToken();
@@ -69,10 +409,10 @@ void Parser::parseLine(Lexer& lex) {
             lex.nextToken();
             Instruction ins{};
             ins.type = InstructionType::INVALID;
-            ins.label = labelName;
+            ins.labelId = labelId;
             ins.line = lline;
             ins.col = lcol;
-            instructions_.push_back(ins);
+            addInstruction(ins);
 
             if (!lex.ended() && lex.currentToken().type == TokenType::T_INSTRUCTION) {
                 parseInstructionAfterIdent(lex, lex.currentToken().text, lex.currentToken().line, lex.currentToken().col);
@@ -92,40 +432,45 @@ void Parser::parseLine(Lexer& lex) {
     }
 }
 
-void Parser::handleDirective(const Token& t) {
+void Parser::handleDirective(Lexer& lex) {
+    Token t = lex.currentToken();
+    lex.nextToken();
+
     if (t.text == "DATA") {
         currentSection_ = Section::DATA;
     }
     else if (t.text == "CODE") {
         currentSection_ = Section::CODE;
     }
+    else if (t.text == "BITS") {
+        // Selects the image mode, so it has to come before anything is emitted
+        Token n = lex.currentToken();
+        if (n.type != TokenType::T_INT || (n.value != 32 && n.value != 64)) {
+            error(".bits expects 32 or 64", n.line, n.col);
+        }
+        if (hasOutput()) {
+            error(".bits must come before any code or data", t.line, t.col);
+        }
+        if (bitsLine_ == 0) {
+            bitsLine_ = t.line;
+            bitsCol_ = t.col;
+        }
+        bits_ = static_cast<int32_t>(n.value);
+        lex.nextToken();
+    }
+    else if (t.text == "INCLUDE") {
+        Token name = lex.currentToken();
+        if (name.type != TokenType::T_STRING) {
+            error(".include expects a quoted file name", name.line, name.col);
+        }
+        lex.nextToken();
+        includeFile(name);
+    }
     else {
-        error("Unknown directive: " + t.text, t.line, t.col);
+        error("Unknown directive: " + std::string(t.text), t.line, t.col);
     }
 }
 
-InstructionType Parser::strToInstr(const std::string& s) {
-    static std::unordered_map<std::string, InstructionType> m = {
-        {"MOV", InstructionType::MOV}, {"ADD", InstructionType::ADD}, {"SUB", InstructionType::SUB},
-        {"MUL", InstructionType::MUL}, {"DIV", InstructionType::DIV}, {"AND", InstructionType::AND},
-        {"OR", InstructionType::OR}, {"XOR", InstructionType::XOR}, {"SHL", InstructionType::SHL},
-        {"SHR", InstructionType::SHR}, {"CMP", InstructionType::CMP}, {"JMP", InstructionType::JMP},
-        {"JE", InstructionType::JE}, {"JNE", InstructionType::JNE}, {"JG", InstructionType::JG},
-        {"JL", InstructionType::JL}, {"JLE", InstructionType::JLE}, {"JGE", InstructionType::JGE},
-        {"LOAD", InstructionType::LOAD}, {"STORE", InstructionType::STORE},
-        {"PUSH", InstructionType::PUSH}, {"POP", InstructionType::POP}, {"CALL", InstructionType::CALL},
-        {"RET", InstructionType::RET}
-    };
-    auto it = m.find(s);
-    if (it != m.end()) return it->second;
-    return InstructionType::INVALID;
-}
-
-int Parser::regNameToIndex(const std::string& r, int32_t line, int32_t col) {
-    int32_t idx = std::stoi(r.substr(1));
-    return idx;
-}
-
 Operand Parser::parseOperand(Lexer& lex) {
     Token t = lex.currentToken();
     Operand op{};
@@ -134,12 +479,13 @@ Operand Parser::parseOperand(Lexer& lex) {
 
     if (t.type == TokenType::T_REGISTER) {
         op.isRegister = true;
-        op.regIndex = regNameToIndex(t.text, t.line, t.col);
+        op.isVector = isVectorRegister(t);
+        op.regIndex = static_cast<int32_t>(t.value);
         lex.nextToken();
     }
     else if (t.type == TokenType::T_LABEL) {
         op.isLabel = true;
-        op.labelName = t.text;
+        op.labelId = labels_.intern(t.text);
         lex.nextToken();
     }
     else if (t.type == TokenType::T_INT) {
@@ -148,27 +494,8 @@ Operand Parser::parseOperand(Lexer& lex) {
     }
     else if (t.type == TokenType::T_LBRACKET) {
         lex.nextToken(); // '['
-        Token inner = lex.currentToken();
-        if (inner.type == TokenType::T_REGISTER) {
-            op.isMemory = true;
-            op.isRegister = true;
-            op.regIndex = regNameToIndex(inner.text, inner.line, inner.col);
-            lex.nextToken();
-        }
-        else if (inner.type == TokenType::T_INT) {
-            op.isMemory = true;
-            op.immediate = inner.value;
-            lex.nextToken();
-        }
-        else if (inner.type == TokenType::T_LABEL) {
-            op.isMemory = true;
-            op.isLabel = true;
-            op.labelName = inner.text;
-            lex.nextToken();
-        }
-        else {
-            error("Invalid memory operand", inner.line, inner.col);
-        }
+        op.isMemory = true;
+        parseAddress(lex, op);
 
         if (lex.currentToken().type != TokenType::T_RBRACKET) {
             Token cur = lex.currentToken();
@@ -183,10 +510,82 @@ Operand Parser::parseOperand(Lexer& lex) {
     return op;
 }
 
-void Parser::parseInstructionAfterIdent(Lexer& lex, const std::string& mnemonic, int32_t line, int32_t col) {
-    InstructionType itype = strToInstr(mnemonic);
+// Memory operand body: a sum of terms, each a register, register*scale, integer or label.
+// At most one label, one base register and one scaled index register.
+// Only integers can be subtracted.
+// [r1+8], [r1-8], [r1 - 8], [table+r2], [r1+r2*4], [table+r2*4+4]
+void Parser::parseAddress(Lexer& lex, Operand& op) {
+    bool negate = false;
+    while (true) {
+        Token term = lex.currentToken();
+        if (negate && term.type != TokenType::T_INT) {
+            error("Only an integer can be subtracted in a memory operand", term.line, term.col);
+        }
+        if (term.type == TokenType::T_REGISTER) {
+            if (isVectorRegister(term)) {
+                error("Vector register cannot address memory", term.line, term.col);
+            }
+            int32_t reg = static_cast<int32_t>(term.value);
+            int32_t scale = 1;
+            lex.nextToken();
+            if (lex.currentToken().type == TokenType::T_STAR) {
+                lex.nextToken(); // '*'
+                Token s = lex.currentToken();
+                if (s.type != TokenType::T_INT || (s.value != 1 && s.value != 2 && s.value != 4 && s.value != 8)) {
+                    error("Index scale must be 1, 2, 4 or 8", s.line, s.col);
+                }
+                scale = static_cast<int32_t>(s.value);
+                lex.nextToken();
+            }
+
+            if (scale == 1 && !op.isRegister) {
+                op.isRegister = true;
+                op.regIndex = reg;
+            }
+            else if (op.indexReg == -1) {
+                op.indexReg = reg;
+                op.scale = scale;
+            }
+            else {
+                error("Too many registers in memory operand", term.line, term.col);
+            }
+        }
+        else if (term.type == TokenType::T_INT) {
+            op.immediate += negate ? -term.value : term.value;
+            lex.nextToken();
+        }
+        else if (term.type == TokenType::T_LABEL) {
+            if (op.isLabel) {
+                error("Only one label allowed in memory operand", term.line, term.col);
+            }
+            op.isLabel = true;
+            op.labelId = labels_.intern(term.text);
+            lex.nextToken();
+        }
+        else {
+            error("Invalid memory operand", term.line, term.col);
+        }
+
+        Token next = lex.currentToken();
+        if (next.type == TokenType::T_PLUS || next.type == TokenType::T_MINUS) {
+            negate = next.type == TokenType::T_MINUS;
+            lex.nextToken();
+            continue;
+        }
+        // "r1-8" lexes as a register followed by a negative integer
+        if (next.type == TokenType::T_INT && next.value < 0) {
+            negate = false;
+            continue;
+        }
+        break;
+    }
+}
+
+void Parser::parseInstructionAfterIdent(Lexer& lex, std::string_view mnemonic, int32_t line, int32_t col) {
+    // The lexer classified the mnemonic already
+    InstructionType itype = lex.currentToken().instr;
     if (itype == InstructionType::INVALID) {
-        error("Invalid instruction: " + mnemonic, line, col);
+        error("Invalid instruction: " + std::string(mnemonic), line, col);
     }
 
     Instruction ins{};
@@ -201,29 +600,46 @@ void Parser::parseInstructionAfterIdent(Lexer& lex, const std::string& mnemonic,
     {
     case InstructionType::ADD: case InstructionType::SUB:
     case InstructionType::MUL: case InstructionType::DIV:
+    case InstructionType::VADD: case InstructionType::VSUB: case InstructionType::VMUL:
+    case InstructionType::VAND: case InstructionType::VXOR: case InstructionType::VCMPEQ:
+    case InstructionType::VCMPGT: case InstructionType::VEXTRACT:
         expectedOperands = 3; break;
 
     case InstructionType::MOV: case InstructionType::AND:
     case InstructionType::OR: case InstructionType::XOR: case InstructionType::SHL:
     case InstructionType::SHR: case InstructionType::CMP: case InstructionType::LOAD:
     case InstructionType::STORE:
+    case InstructionType::CMOVE: case InstructionType::CMOVNE: case InstructionType::CMOVG:
+    case InstructionType::CMOVL: case InstructionType::CMOVLE: case InstructionType::CMOVGE:
+    case InstructionType::LOOP:
+    case InstructionType::VLOAD: case InstructionType::VSTORE: case InstructionType::VSPLAT:
+    case InstructionType::ALLOC:
         expectedOperands = 2; break;
 
     case InstructionType::PUSH: case InstructionType::POP:
     case InstructionType::JMP: case InstructionType::JE: case InstructionType::JNE:
     case InstructionType::JG: case InstructionType::JL: case InstructionType::CALL:
     case InstructionType::JLE: case InstructionType::JGE:
+    case InstructionType::ENTER:
+    case InstructionType::SETE: case InstructionType::SETNE: case InstructionType::SETG:
+    case InstructionType::SETL: case InstructionType::SETLE: case InstructionType::SETGE:
+    case InstructionType::FREE:
         expectedOperands = 1; break;
 
-    case InstructionType::RET:
+    case InstructionType::RET: case InstructionType::LEAVE:
         expectedOperands = 0; break;
 
+    case InstructionType::PUSHM: case InstructionType::POPM:
+        parseRegisterList(lex, ins, mnemonic);
+        addInstruction(ins);
+        return;
+
     default: break;
     }
 
     for (int32_t i = 0; i < expectedOperands; i++) {
         if (lex.ended() || lex.currentToken().type == TokenType::T_END_OF_FILE) {
-            error("Not enough operands for " + mnemonic, line, col);
+            error("Not enough operands for " + std::string(mnemonic), line, col);
         }
 
         Operand op = parseOperand(lex);
@@ -238,16 +654,105 @@ void Parser::parseInstructionAfterIdent(Lexer& lex, const std::string& mnemonic,
         }
     }
 
-    instructions_.push_back(ins);
+    if (itype == InstructionType::ENTER && (ins.operands[0].isRegister || ins.operands[0].isMemory || ins.operands[0].isLabel)) {
+        error("ENTER expects an immediate frame size", ins.operands[0].line, ins.operands[0].col);
+    }
+
+    checkVectorOperands(ins, mnemonic);
+    for (const auto& op : ins.operands) {
+        checkImmediateRange(op);
+    }
+
+    if (itype == InstructionType::LOOP && (!ins.operands[0].isRegister || ins.operands[0].isMemory || ins.operands[0].regIndex >= 14)) {
+        error("LOOP counter must be one of R0-R13", ins.operands[0].line, ins.operands[0].col);
+    }
+
+    addInstruction(ins);
+}
+
+// Vector instructions take V registers exactly where their shape says, scalar ones never do.
+// Shape letters: v = vector register, m = memory, r = scalar register,
+// s = any scalar source, i = immediate
+void Parser::checkVectorOperands(const Instruction& ins, std::string_view mnemonic) {
+    const char* shape = nullptr;
+    switch (ins.type) {
+    case InstructionType::VLOAD:    shape = "vm"; break;
+    case InstructionType::VSTORE:   shape = "mv"; break;
+    case InstructionType::VADD: case InstructionType::VSUB: case InstructionType::VMUL:
+    case InstructionType::VAND: case InstructionType::VXOR: case InstructionType::VCMPEQ:
+    case InstructionType::VCMPGT:   shape = "vvv"; break;
+    case InstructionType::VSPLAT:   shape = "vs"; break;
+    case InstructionType::VEXTRACT: shape = "rvi"; break;
+    default: break;
+    }
+
+    for (size_t i = 0; i < ins.operands.size(); i++) {
+        const Operand& op = ins.operands[i];
+        bool ok = true;
+        switch (shape ? shape[i] : 's') {
+        case 'v': ok = op.isVector && !op.isMemory; break;
+        case 'm': ok = op.isMemory; break;
+        case 'r': ok = op.isRegister && !op.isVector && !op.isMemory; break;
+        case 's': ok = !op.isVector; break;
+        case 'i': ok = !op.isRegister && !op.isMemory && !op.isLabel && op.immediate >= 0 && op.immediate < 4; break;
+        }
+        if (!ok) {
+            error("Invalid operand " + std::to_string(i + 1) + " for " + std::string(mnemonic), op.line, op.col);
+        }
+    }
+}
+
+// Addresses and displacements are encoded as int32 in both modes, so memory
+// above 2 GB is reached through a register. Plain immediates get the full
+// register width; 32-bit mode also accepts unsigned values like 4294967295.
+void Parser::checkImmediateRange(const Operand& op) {
+    if (op.isMemory) {
+        if (op.immediate < INT32_MIN || op.immediate > INT32_MAX) {
+            error("Memory displacement out of range", op.line, op.col);
+        }
+    }
+    else if (!op.isRegister && !op.isLabel && bits_ == 32) {
+        if (op.immediate < INT32_MIN || op.immediate > UINT32_MAX) {
+            error("Immediate out of range in 32-bit mode, use .bits 64", op.line, op.col);
+        }
+    }
+}
+
+// PUSHM/POPM take either a list of registers (r0, r1, r5) or a single immediate bitmask
+void Parser::parseRegisterList(Lexer& lex, Instruction& ins, std::string_view mnemonic) {
+    while (true) {
+        if (lex.ended()) {
+            error("Not enough operands for " + std::string(mnemonic), ins.line, ins.col);
+        }
+
+        Operand op = parseOperand(lex);
+        if (op.isMemory || op.isLabel || op.isVector) {
+            error(std::string(mnemonic) + " expects registers or a register mask", op.line, op.col);
+        }
+        if (op.isRegister && op.regIndex >= 14) {
+            error("R14/R15 cannot be saved with " + std::string(mnemonic), op.line, op.col);
+        }
+        if (!op.isRegister && (!ins.operands.empty() || op.immediate < 0 || op.immediate > 0x3FFF)) {
+            error("Invalid register mask for " + std::string(mnemonic), op.line, op.col);
+        }
+        ins.operands.push_back(op);
+
+        if (lex.ended()) break;
+        if (!op.isRegister || lex.currentToken().type != TokenType::T_COMMA) {
+            Token cur = lex.currentToken();
+            error("Expected comma after operand", cur.line, cur.col);
+        }
+        lex.nextToken(); // consume comma
+    }
 }
 
 void Parser::parseDataLine(Lexer& lex) {
     if (lex.ended()) return;
 
-    std::string labelName;
+    int32_t labelId = -1;
     Token first = lex.currentToken();
     if (first.type == TokenType::T_LABEL) {
-        labelName = first.text;
+        labelId = labels_.intern(first.text);
         lex.nextToken();
         if (lex.ended() || lex.currentToken().type != TokenType::T_COLON) {
             error("Expected ':' after label", first.line, first.col);
@@ -256,31 +761,52 @@ void Parser::parseDataLine(Lexer& lex) {
     }
 
     if (lex.ended()) {
-        if (!labelName.empty()) {
-            dataLabels_[labelName] = dataOffset_;
+        if (labelId != -1) {
+            dataLabels_[labelId] = dataOffset_;
         }
         return;
     }
 
     // Expect a data directive like "WORD"
     Token dtok = lex.currentToken();
-    if (dtok.type == TokenType::T_DIRECTIVE && dtok.text == "WORD") {
-        lex.nextToken(); // consume WORD directive
-        parseWordList(lex, labelName);
+    if (dtok.type == TokenType::T_DIRECTIVE && (dtok.text == "WORD" || dtok.text == "DWORD")) {
+        lex.nextToken(); // consume WORD/DWORD directive
+        parseWordList(lex, labelId, dtok.text == "DWORD");
+    }
+    else if (dtok.type == TokenType::T_DIRECTIVE && dtok.text == "JUMPTABLE") {
+        lex.nextToken(); // consume JUMPTABLE directive
+        parseJumpTable(lex, labelId);
     }
     else {
-        error("Expected .word directive in data section", dtok.line, dtok.col);
+        error("Expected .word, .dword or .jumptable directive in data section", dtok.line, dtok.col);
     }
 }
 
-void Parser::parseWordList(Lexer& lex, const std::string& labelName) {
+// .word emits 4 bytes per value, .dword 8 (low word first)
+void Parser::parseWordList(Lexer& lex, int32_t labelId, bool dword) {
+    // A label names the first word of its list, as a byte offset into the data segment
+    if (labelId != -1) {
+        dataLabels_[labelId] = dataOffset_;
+    }
+
     bool firstVal = true;
     while (!lex.ended()) {
         Token val = lex.currentToken();
         if (val.type == TokenType::T_INT) {
-            int32_t wordVal = (int32_t)val.value;
-            dataSegment_.push_back(wordVal);
-            dataOffset_ += 4;
+            if (dword) {
+                uint64_t bits = static_cast<uint64_t>(val.value);
+                dataSegment_.push_back(static_cast<int32_t>(bits & 0xFFFFFFFF));
+                dataSegment_.push_back(static_cast<int32_t>(bits >> 32));
+                dataOffset_ += 8;
+            }
+            else {
+                if (val.value < INT32_MIN || val.value > UINT32_MAX) {
+                    error(".word value out of range, use .dword", val.line, val.col);
+                }
+                int32_t wordVal = (int32_t)val.value;
+                dataSegment_.push_back(wordVal);
+                dataOffset_ += 4;
+            }
             lex.nextToken();
             if (lex.ended()) break;
             if (lex.currentToken().type == TokenType::T_COMMA) {
@@ -295,9 +821,34 @@ void Parser::parseWordList(Lexer& lex, const std::string& labelName) {
             break;
         }
     }
+}
 
-    if (!labelName.empty()) {
-        dataLabels_[labelName] = dataOffset_ - 4;
+// .jumptable case0, case1, ... emits one register-sized word per label, which
+// the linker fills in with the label's address. Dispatch with jmp [table+rN*4]
+// (rN*8 under .bits 64).
+void Parser::parseJumpTable(Lexer& lex, int32_t labelId) {
+    if (labelId != -1) {
+        dataLabels_[labelId] = dataOffset_;
+    }
+
+    while (true) {
+        Token entry = lex.currentToken();
+        if (entry.type != TokenType::T_LABEL) {
+            error("Expected label in .jumptable", entry.line, entry.col);
+        }
+        dataRelocs_.push_back({ dataOffset_, labels_.intern(entry.text) });
+        for (int32_t i = 0; i < bits_ / 32; i++) {
+            dataSegment_.push_back(0);
+            dataOffset_ += 4;
+        }
+
+        lex.nextToken();
+        if (lex.ended()) break;
+        if (lex.currentToken().type != TokenType::T_COMMA) {
+            Token cur = lex.currentToken();
+            error("Expected comma in .jumptable", cur.line, cur.col);
+        }
+        lex.nextToken();
     }
 }
 
@@ -3,24 +3,24 @@
 #pragma once
 
 #include "Lexer.hpp"
+#include "LabelTable.hpp"
+#include <vector>
+#include <memory>
+#include <functional>
 
-enum class InstructionType {
-    MOV = 0, ADD = 1, SUB = 2, MUL = 3, DIV = 4, AND = 5, OR = 6, XOR = 7, SHL = 8, SHR = 9, CMP = 10,
-    JMP = 11, JE = 12, JNE = 13, JG = 14, JL = 15, JLE = 16, JGE = 17,
-    LOAD = 18, STORE = 19,
-    PUSH = 20, POP = 21,
-    CALL = 22, RET = 23,
-    INVALID = 24
-};
-
+class ThreadPool;
+class ModuleCache;
 
 struct Operand {
     bool isRegister = false;
     bool isMemory = false;
     int32_t regIndex = -1;
+    bool isVector = false;  // regIndex names V0-V7 rather than R0-R15
     int64_t immediate = 0;
     bool isLabel = false;
-    std::string labelName;
+    int32_t labelId = -1;   // into the Parser's LabelTable
+    int32_t indexReg = -1;  // memory operands only: [base + index*scale + disp]
+    int32_t scale = 1;
     int32_t line;
     int32_t col;
 };
@@ -29,43 +29,108 @@ struct Operand {
 struct Instruction {
     InstructionType type;
     std::vector<Operand> operands;
-    std::string label;
+    int32_t labelId = -1;   // the label defined here, type INVALID only
     int32_t line;
     int32_t col;
 };
 
+// A data word holding the address of a label, e.g. a .jumptable entry
+struct DataReloc {
+    int32_t offset; // byte offset into the data segment
+    int32_t labelId;
+};
+
 enum class Section {
     CODE = 0,
     DATA
 };
 
+// Takes each instruction, label definitions included, as soon as it is parsed,
+// with the .bits mode in force
+using InstructionHandler = std::function<void(const Instruction& ins, int32_t bits)>;
+
 class Parser {
 public:
     Parser(const std::vector<std::string>& lines, bool debug = false);
 
+    // Whole source in one buffer, lexed in place
+    Parser(std::string_view source, bool debug = false);
+
+    // As above, but a large source is split into chunks at line boundaries
+    // that are lexed and parsed in parallel on pool, then merged. The result
+    // is the same as parsing sequentially. Files named by .include are shared
+    // through modules when given, and relative ones resolve against directory.
+    Parser(std::string_view source, ThreadPool& pool, bool debug = false,
+        ModuleCache* modules = nullptr, const std::string& directory = "");
+
+    // Streaming: instructions go to onInstruction in source order instead of
+    // being kept, so getInstructions() stays empty. Data, labels and the mode
+    // are collected as usual. Always parses sequentially.
+    Parser(std::string_view source, InstructionHandler onInstruction, bool debug = false,
+        ModuleCache* modules = nullptr, const std::string& directory = "");
+
     const std::vector<Instruction>& getInstructions() const;
     const std::vector<int32_t>& getDataSegment() const;
-    const std::unordered_map<std::string, int32_t>& getDataLabels() const;
+    // Label ID to byte offset into the data segment
+    const std::unordered_map<int32_t, int32_t>& getDataLabels() const;
+    const std::vector<DataReloc>& getDataRelocs() const;
+
+    // Every label named in the source, defined or referenced
+    const LabelTable& getLabels() const;
+
+    // 32 unless the source starts with ".bits 64"
+    int32_t getBits() const;
+
+    // Whether the pool constructor splits a source of this size into chunks
+    static bool parsesInChunks(size_t sourceBytes, const ThreadPool& pool);
+
+    // Full path of an .include name written in a file in directory ("" for
+    // the working directory)
+    static std::string resolveInclude(std::string_view name, const std::string& directory);
 
 private:
-    void parseLine(Lexer& lex);
-    void handleDirective(const Token& t);
+    // Empty parser for a chunk or included file, starting in the given state
+    // and sharing parent's include context
+    Parser(const Parser& parent, Section section, int32_t bits);
+    void parseSource(std::string_view source, int32_t firstLine = 1);
+    void mergeChunks(std::vector<std::unique_ptr<Parser>>& chunks, ThreadPool& pool);
+    std::vector<int32_t> internLabels(const Parser& part);
+    void appendDataSymbols(const Parser& part, const std::vector<int32_t>& map, int32_t offsetBase);
+    void includeFile(const Token& name);
+    std::shared_ptr<const Parser> loadModule(const std::string& path);
+    void addInstruction(Instruction& ins);
+    bool hasOutput() const;
 
-    InstructionType strToInstr(const std::string& s);
-    int regNameToIndex(const std::string& r, int32_t line, int32_t col);
+    void parseLine(Lexer& lex);
+    void handleDirective(Lexer& lex);
 
     Operand parseOperand(Lexer& lex);
-    void parseInstructionAfterIdent(Lexer& lex, const std::string& mnemonic, int32_t line, int32_t col);
+    void parseAddress(Lexer& lex, Operand& op);
+    void parseInstructionAfterIdent(Lexer& lex, std::string_view mnemonic, int32_t line, int32_t col);
+    void parseRegisterList(Lexer& lex, Instruction& ins, std::string_view mnemonic);
+    void checkVectorOperands(const Instruction& ins, std::string_view mnemonic);
+    void checkImmediateRange(const Operand& op);
     void parseDataLine(Lexer& lex);
-    void parseWordList(Lexer& lex, const std::string& labelName);
+    void parseWordList(Lexer& lex, int32_t labelId, bool dword);
+    void parseJumpTable(Lexer& lex, int32_t labelId);
 
     void error(const std::string& msg, int32_t line, int32_t col) const;
 
     std::vector<Instruction> instructions_;
+    InstructionHandler onInstruction_;  // set when streaming
+    size_t streamed_ = 0;               // instructions handed to onInstruction_
     Section currentSection_ = Section::CODE;
 
     std::vector<int32_t> dataSegment_;
-    std::unordered_map<std::string, int32_t> dataLabels_;
+    std::unordered_map<int32_t, int32_t> dataLabels_;
+    LabelTable labels_;
+    std::vector<DataReloc> dataRelocs_;
     int32_t dataOffset_ = 0;
+    int32_t bits_ = 32;
+    int32_t bitsLine_ = 0;  // where the first .bits was, checked again when chunks merge
+    int32_t bitsCol_ = 0;
+    ModuleCache* modules_ = nullptr;
+    std::string directory_;                 // .include paths resolve against this
+    std::vector<std::string> includeStack_; // files this one is included from, to catch cycles
     bool debug_ = false;
 };
\ No newline at end of file
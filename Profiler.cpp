@@ -0,0 +1,181 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#include "Profiler.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+Profiler::Profiler(const std::vector<Symbol>& symbols, const std::vector<std::string>& names,
+    ProfileMode mode, uint32_t sampleInterval)
+    : mode_(mode), sampleInterval_(sampleInterval == 0 ? 1 : sampleInterval), countdown_(sampleInterval_)
+{
+    for (const auto& sym : symbols) {
+        if (sym.isExternal || sym.isData) continue;
+        byAddress_.emplace_back(sym.address, static_cast<int32_t>(names_.size()));
+        names_.push_back(names[sym.nameId]);
+    }
+    std::sort(byAddress_.begin(), byAddress_.end());
+
+    // The linker always enters the program through MAIN, so that is the root frame
+    int32_t root = -1;
+    for (size_t i = 0; i < names_.size(); i++) {
+        if (names_[i] == "MAIN") {
+            root = static_cast<int32_t>(i);
+            break;
+        }
+    }
+    if (root == -1) {
+        root = static_cast<int32_t>(names_.size());
+        names_.push_back("[root]");
+    }
+
+    nodes_.push_back({ root, -1, 0 });
+}
+
+void Profiler::begin() {
+    stack_.clear();
+    stack_.push_back(0);
+    countdown_ = sampleInterval_;
+    lastSample_ = std::chrono::steady_clock::now();
+}
+
+void Profiler::end() {
+    if (mode_ == ProfileMode::WALL_TIME && !stack_.empty()) {
+        sample();
+    }
+}
+
+void Profiler::onCall(int32_t target) {
+    if (mode_ == ProfileMode::WALL_TIME) {
+        sample();
+    }
+    stack_.push_back(childNode(stack_.back(), resolveFunction(target)));
+}
+
+void Profiler::onReturn() {
+    if (mode_ == ProfileMode::WALL_TIME) {
+        sample();
+    }
+    // Guest code is free to unbalance the stack; never pop the root frame
+    if (stack_.size() > 1) {
+        stack_.pop_back();
+    }
+}
+
+void Profiler::sample() {
+    auto now = std::chrono::steady_clock::now();
+    nodes_[stack_.back()].self += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastSample_).count());
+    lastSample_ = now;
+    countdown_ = sampleInterval_;
+}
+
+int32_t Profiler::resolveFunction(int32_t addr) {
+    auto it = std::upper_bound(byAddress_.begin(), byAddress_.end(),
+        std::make_pair(addr, INT32_MAX));
+    if (it != byAddress_.begin()) {
+        return std::prev(it)->second;
+    }
+
+    // Target lies before any known label, name it by address
+    auto unk = unknownFunctions_.find(addr);
+    if (unk != unknownFunctions_.end()) {
+        return unk->second;
+    }
+    std::ostringstream name;
+    name << "[0x" << std::hex << addr << "]";
+    int32_t fn = static_cast<int32_t>(names_.size());
+    names_.push_back(name.str());
+    unknownFunctions_[addr] = fn;
+    return fn;
+}
+
+int32_t Profiler::childNode(int32_t parent, int32_t function) {
+    uint64_t key = (static_cast<uint64_t>(parent) << 32) | static_cast<uint32_t>(function);
+    auto it = children_.find(key);
+    if (it != children_.end()) {
+        return it->second;
+    }
+    int32_t node = static_cast<int32_t>(nodes_.size());
+    nodes_.push_back({ function, parent, 0 });
+    children_[key] = node;
+    return node;
+}
+
+std::string Profiler::pathOf(int32_t node) const {
+    std::vector<int32_t> chain;
+    for (int32_t n = node; n != -1; n = nodes_[n].parent) {
+        chain.push_back(nodes_[n].function);
+    }
+    std::string path;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        if (!path.empty()) path += ';';
+        path += names_[*it];
+    }
+    return path;
+}
+
+void Profiler::writeCollapsed(std::ostream& os) const {
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        if (nodes_[i].self == 0) continue;
+        os << pathOf(static_cast<int32_t>(i)) << " " << nodes_[i].self << "\n";
+    }
+}
+
+void Profiler::writeCollapsed(const std::string& path) const {
+    std::ofstream ofs(path);
+    if (!ofs) {
+        throw std::runtime_error("Failed to open file for writing: " + path);
+    }
+    writeCollapsed(ofs);
+}
+
+void Profiler::printReport() const {
+    // Children are always created after their parent, so a reverse walk
+    // accumulates inclusive cost bottom-up in one pass
+    std::vector<uint64_t> inclusive(nodes_.size(), 0);
+    for (size_t i = nodes_.size(); i-- > 0;) {
+        inclusive[i] += nodes_[i].self;
+        if (nodes_[i].parent != -1) {
+            inclusive[nodes_[i].parent] += inclusive[i];
+        }
+    }
+
+    std::vector<uint64_t> fnSelf(names_.size(), 0);
+    std::vector<uint64_t> fnInclusive(names_.size(), 0);
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        int32_t fn = nodes_[i].function;
+        fnSelf[fn] += nodes_[i].self;
+
+        // Only the outermost frame of a recursive function counts towards its inclusive cost
+        bool recursive = false;
+        for (int32_t p = nodes_[i].parent; p != -1; p = nodes_[p].parent) {
+            if (nodes_[p].function == fn) {
+                recursive = true;
+                break;
+            }
+        }
+        if (!recursive) {
+            fnInclusive[fn] += inclusive[i];
+        }
+    }
+
+    std::vector<int32_t> order;
+    for (size_t i = 0; i < names_.size(); i++) {
+        if (fnInclusive[i] != 0) order.push_back(static_cast<int32_t>(i));
+    }
+    std::sort(order.begin(), order.end(), [&](int32_t a, int32_t b) {
+        return fnInclusive[a] > fnInclusive[b];
+        });
+
+    const char* unit = (mode_ == ProfileMode::INSTRUCTIONS) ? "instructions" : "ns";
+    std::cout << "\n--- Profile (" << unit << ") ---\n";
+    std::cout << std::setw(14) << "inclusive" << std::setw(14) << "self" << "  function\n";
+    for (int32_t fn : order) {
+        std::cout << std::setw(14) << fnInclusive[fn] << std::setw(14) << fnSelf[fn] << "  " << names_[fn] << "\n";
+    }
+    std::cout << "--- End of Profile ---\n\n";
+}
@@ -0,0 +1,69 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#pragma once
+
+#include "ObjectFile.hpp"
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+enum class ProfileMode {
+    INSTRUCTIONS = 0,   // one unit per retired instruction
+    WALL_TIME           // nanoseconds, sampled every sampleInterval instructions
+};
+
+// Call-graph profiler driven by the VM. Keeps a shadow call stack from
+// CALL/RET and attributes cost to the full call path, so output can be fed
+// straight into flamegraph tools (collapsed-stack format).
+class Profiler {
+public:
+    // names is the table the symbols' nameId indexes, see Linker::getSymbolNames()
+    Profiler(const std::vector<Symbol>& symbols, const std::vector<std::string>& names,
+        ProfileMode mode = ProfileMode::INSTRUCTIONS, uint32_t sampleInterval = 1024);
+
+    void begin();
+    void end();
+
+    inline void onInstruction() {
+        if (mode_ == ProfileMode::INSTRUCTIONS) {
+            nodes_[stack_.back()].self++;
+        }
+        else if (--countdown_ == 0) {
+            sample();
+        }
+    }
+
+    void onCall(int32_t target);
+    void onReturn();
+
+    void writeCollapsed(std::ostream& os) const;
+    void writeCollapsed(const std::string& path) const;
+    void printReport() const;
+
+private:
+    struct Node {
+        int32_t function;   // index into names_
+        int32_t parent;     // -1 for the root
+        uint64_t self = 0;
+    };
+
+    int32_t resolveFunction(int32_t addr);
+    int32_t childNode(int32_t parent, int32_t function);
+    void sample();
+    std::string pathOf(int32_t node) const;
+
+    std::vector<std::string> names_;
+    std::vector<std::pair<int32_t, int32_t>> byAddress_; // (address, function), sorted
+    std::unordered_map<int32_t, int32_t> unknownFunctions_;
+    std::vector<Node> nodes_;
+    std::unordered_map<uint64_t, int32_t> children_; // (parent << 32 | function) -> node
+    std::vector<int32_t> stack_;
+
+    ProfileMode mode_;
+    uint32_t sampleInterval_;
+    uint32_t countdown_;
+    std::chrono::steady_clock::time_point lastSample_;
+};
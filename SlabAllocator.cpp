@@ -0,0 +1,225 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#include "SlabAllocator.hpp"
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+
+SlabAllocator::SlabAllocator(int64_t base, int64_t end) {
+    // Never hand out address 0, it is the "out of memory" result
+    base_ = (base + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    if (base_ == 0) {
+        base_ = PAGE_SIZE;
+    }
+
+    int64_t pages = end > base_ ? (end - base_) / PAGE_SIZE : 0;
+    pages_.resize(static_cast<size_t>(pages));
+    if (pages > 0) {
+        freeRuns_[0] = pages;
+    }
+    stats_.heapBytes = pages * PAGE_SIZE;
+}
+
+int64_t SlabAllocator::allocate(int64_t size) {
+    if (size <= 0) {
+        size = 1;
+    }
+
+    int64_t addr = 0;
+    int64_t rounded = 0;
+    if (size <= blockSize(CLASS_COUNT - 1)) {
+        int32_t sizeClass = 0;
+        while (blockSize(sizeClass) < size) sizeClass++;
+
+        std::vector<int64_t>& freeList = freeBlocks_[sizeClass];
+        if (freeList.empty() && !refill(sizeClass)) {
+            stats_.failures++;
+            return 0;
+        }
+        addr = freeList.back();
+        freeList.pop_back();
+
+        rounded = blockSize(sizeClass);
+        int64_t offset = addr - base_;
+        pages_[offset / PAGE_SIZE].requested[(offset % PAGE_SIZE) / rounded] = size;
+    }
+    else {
+        int64_t count = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+        int64_t first = takePages(count);
+        if (first < 0) {
+            stats_.failures++;
+            return 0;
+        }
+
+        Page& head = pages_[first];
+        head.sizeClass = LARGE_HEAD;
+        head.runPages = count;
+        head.requested.assign(1, size);
+        for (int64_t i = 1; i < count; i++) {
+            pages_[first + i].sizeClass = LARGE_TAIL;
+        }
+
+        addr = base_ + first * PAGE_SIZE;
+        rounded = count * PAGE_SIZE;
+    }
+
+    stats_.allocations++;
+    stats_.liveBlocks++;
+    stats_.bytesRequested += size;
+    stats_.bytesAllocated += rounded;
+    if (stats_.bytesAllocated > stats_.peakBytesAllocated) {
+        stats_.peakBytesAllocated = stats_.bytesAllocated;
+    }
+    return addr;
+}
+
+void SlabAllocator::release(int64_t addr) {
+    if (addr == 0) {
+        return;
+    }
+
+    int64_t offset = addr - base_;
+    if (offset < 0 || offset >= static_cast<int64_t>(pages_.size()) * PAGE_SIZE) {
+        throw std::runtime_error("FREE of address outside the heap: " + std::to_string(addr));
+    }
+
+    int64_t pageIndex = offset / PAGE_SIZE;
+    int64_t pageOffset = offset % PAGE_SIZE;
+    Page& page = pages_[pageIndex];
+
+    if (page.sizeClass >= 0) {
+        int64_t size = blockSize(page.sizeClass);
+        int64_t slot = pageOffset / size;
+        if (pageOffset % size != 0 || page.requested[slot] == 0) {
+            throw std::runtime_error("FREE of address that is not allocated: " + std::to_string(addr));
+        }
+
+        stats_.bytesRequested -= page.requested[slot];
+        stats_.bytesAllocated -= size;
+        page.requested[slot] = 0;
+        // Pages stay with their size class, freed blocks are reused by the next ALLOC of that class
+        freeBlocks_[page.sizeClass].push_back(addr);
+    }
+    else if (page.sizeClass == LARGE_HEAD && pageOffset == 0) {
+        int64_t count = page.runPages;
+        stats_.bytesRequested -= page.requested[0];
+        stats_.bytesAllocated -= count * PAGE_SIZE;
+        for (int64_t i = 0; i < count; i++) {
+            Page& p = pages_[pageIndex + i];
+            p.sizeClass = FREE_PAGE;
+            p.runPages = 0;
+            p.requested.clear();
+        }
+        returnPages(pageIndex, count);
+    }
+    else {
+        throw std::runtime_error("FREE of address that is not allocated: " + std::to_string(addr));
+    }
+
+    stats_.frees++;
+    stats_.liveBlocks--;
+}
+
+bool SlabAllocator::refill(int32_t sizeClass) {
+    int64_t pageIndex = takePages(1);
+    if (pageIndex < 0) {
+        return false;
+    }
+
+    int64_t size = blockSize(sizeClass);
+    int64_t blocks = PAGE_SIZE / size;
+    Page& page = pages_[pageIndex];
+    page.sizeClass = sizeClass;
+    page.requested.assign(static_cast<size_t>(blocks), 0);
+
+    // Pushed highest first so blocks are handed out in address order
+    int64_t pageAddr = base_ + pageIndex * PAGE_SIZE;
+    std::vector<int64_t>& freeList = freeBlocks_[sizeClass];
+    for (int64_t i = blocks - 1; i >= 0; i--) {
+        freeList.push_back(pageAddr + i * size);
+    }
+    return true;
+}
+
+int64_t SlabAllocator::takePages(int64_t count) {
+    for (auto it = freeRuns_.begin(); it != freeRuns_.end(); ++it) {
+        if (it->second < count) continue;
+
+        int64_t first = it->first;
+        int64_t remaining = it->second - count;
+        freeRuns_.erase(it);
+        if (remaining > 0) {
+            freeRuns_[first + count] = remaining;
+        }
+        return first;
+    }
+    return -1;
+}
+
+void SlabAllocator::returnPages(int64_t first, int64_t count) {
+    auto next = freeRuns_.lower_bound(first);
+    if (next != freeRuns_.end() && next->first == first + count) {
+        count += next->second;
+        next = freeRuns_.erase(next);
+    }
+    if (next != freeRuns_.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == first) {
+            prev->second += count;
+            return;
+        }
+    }
+    freeRuns_[first] = count;
+}
+
+SlabAllocator::Stats SlabAllocator::stats() const {
+    Stats s = stats_;
+    s.freeBytes = 0;
+    s.largestFreeRun = 0;
+    for (const auto& [first, count] : freeRuns_) {
+        s.freeBytes += count * PAGE_SIZE;
+        if (count * PAGE_SIZE > s.largestFreeRun) {
+            s.largestFreeRun = count * PAGE_SIZE;
+        }
+    }
+    for (const auto& page : pages_) {
+        if (page.sizeClass >= 0) {
+            s.classPages[page.sizeClass]++;
+        }
+    }
+    for (int32_t c = 0; c < CLASS_COUNT; c++) {
+        s.classFree[c] = static_cast<int64_t>(freeBlocks_[c].size());
+        s.classLive[c] = s.classPages[c] * (PAGE_SIZE / blockSize(c)) - s.classFree[c];
+        s.freeBytes += s.classFree[c] * blockSize(c);
+    }
+    return s;
+}
+
+void SlabAllocator::printStats() const {
+    Stats s = stats();
+    auto percent = [](int64_t part, int64_t whole) {
+        return whole ? 100.0 * static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+    };
+
+    std::cout << "\n--- Heap ---\n";
+    std::cout << "Heap size: " << s.heapBytes << " bytes\n";
+    std::cout << "Allocations: " << s.allocations << ", frees: " << s.frees
+        << ", failed: " << s.failures << ", live: " << s.liveBlocks << "\n";
+    std::cout << "Live bytes: " << s.bytesRequested << " requested, " << s.bytesAllocated
+        << " allocated, peak " << s.peakBytesAllocated << "\n";
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Internal fragmentation: " << percent(s.bytesAllocated - s.bytesRequested, s.bytesAllocated)
+        << "% of allocated bytes lost to rounding\n";
+    std::cout << "External fragmentation: " << percent(s.freeBytes - s.largestFreeRun, s.freeBytes)
+        << "% of free bytes outside the largest free page run\n";
+
+    std::cout << "  " << std::setw(8) << "class" << std::setw(8) << "pages"
+        << std::setw(10) << "live" << std::setw(10) << "free" << "\n";
+    for (int32_t c = 0; c < CLASS_COUNT; c++) {
+        if (s.classPages[c] == 0) continue;
+        std::cout << "  " << std::setw(8) << blockSize(c) << std::setw(8) << s.classPages[c]
+            << std::setw(10) << s.classLive[c] << std::setw(10) << s.classFree[c] << "\n";
+    }
+    std::cout << std::defaultfloat << "--- End of Heap ---\n\n";
+}
@@ -0,0 +1,70 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <cstdint>
+
+// Guest heap behind ALLOC/FREE, handing out addresses in [base, end) of VM
+// memory. Requests up to 2KB round up to a power-of-two size class and are
+// carved from 4KB pages owned by that class; each class keeps a stack of free
+// blocks, so the common ALLOC/FREE is a pop or push. Larger requests take a
+// run of whole pages, first fit. All bookkeeping is host side, a guest
+// scribbling over its heap cannot corrupt the allocator.
+class SlabAllocator {
+public:
+    static constexpr int64_t PAGE_SIZE = 4096;
+    static constexpr int64_t MIN_BLOCK = 16;
+    static constexpr int32_t CLASS_COUNT = 8; // 16 bytes up to 2KB
+
+    struct Stats {
+        uint64_t allocations = 0;
+        uint64_t frees = 0;
+        uint64_t failures = 0;          // ALLOCs that returned 0
+        uint64_t liveBlocks = 0;
+        int64_t bytesRequested = 0;     // live, as asked for
+        int64_t bytesAllocated = 0;     // live, rounded up to block or page size
+        int64_t peakBytesAllocated = 0;
+        int64_t heapBytes = 0;
+        int64_t freeBytes = 0;          // free pages plus free blocks in class pages
+        int64_t largestFreeRun = 0;     // biggest run of free pages, in bytes
+        int64_t classPages[CLASS_COUNT] = {};
+        int64_t classLive[CLASS_COUNT] = {};
+        int64_t classFree[CLASS_COUNT] = {};
+    };
+
+    SlabAllocator(int64_t base = 0, int64_t end = 0);
+
+    // Returns 0 when the heap cannot satisfy the request
+    int64_t allocate(int64_t size);
+
+    // Throws unless addr is a live allocation, 0 is ignored
+    void release(int64_t addr);
+
+    Stats stats() const;
+    void printStats() const;
+
+private:
+    static constexpr int32_t FREE_PAGE = -1;
+    static constexpr int32_t LARGE_HEAD = -2;
+    static constexpr int32_t LARGE_TAIL = -3;
+
+    struct Page {
+        int32_t sizeClass = FREE_PAGE;  // size class, or one of the markers above
+        int64_t runPages = 0;           // LARGE_HEAD only
+        std::vector<int64_t> requested; // bytes asked for per block, 0 = free
+    };
+
+    static int64_t blockSize(int32_t sizeClass) { return MIN_BLOCK << sizeClass; }
+
+    bool refill(int32_t sizeClass);
+    int64_t takePages(int64_t count);
+    void returnPages(int64_t first, int64_t count);
+
+    int64_t base_ = 0;
+    std::vector<Page> pages_;
+    std::map<int64_t, int64_t> freeRuns_;            // first page -> page count
+    std::vector<int64_t> freeBlocks_[CLASS_COUNT];   // free block addresses per class
+    Stats stats_;
+};
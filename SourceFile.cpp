@@ -0,0 +1,93 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#include "SourceFile.hpp"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+SourceFile::SourceFile(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        throw std::runtime_error("Failed to read size of " + path);
+    }
+    file_ = file;
+    size_ = static_cast<size_t>(size.QuadPart);
+
+    // Empty files cannot be mapped, they are simply an empty view
+    if (size_ == 0) {
+        return;
+    }
+
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_) {
+        data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!data_) {
+        if (mapping_) CloseHandle(mapping_);
+        CloseHandle(file);
+        throw std::runtime_error("Failed to map " + path);
+    }
+}
+
+SourceFile::~SourceFile() {
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_) CloseHandle(file_);
+}
+
+#else
+
+SourceFile::SourceFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to read size of " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+
+    // Empty files cannot be mapped, they are simply an empty view
+    if (size_ > 0) {
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Failed to map " + path);
+        }
+        madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(p);
+    }
+    // The mapping keeps the file referenced
+    close(fd);
+}
+
+SourceFile::~SourceFile() {
+    if (data_) munmap(const_cast<char*>(data_), size_);
+}
+
+#endif
+
+std::string_view SourceFile::text() const {
+    return std::string_view(data_, size_);
+}
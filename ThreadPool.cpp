@@ -0,0 +1,101 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int32_t threads) {
+    if (threads <= 0) {
+        threads = static_cast<int32_t>(std::thread::hardware_concurrency());
+    }
+    // The thread calling run() is the last worker
+    for (int32_t i = 1; i < threads; i++) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    workAvailable_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+int32_t ThreadPool::size() const {
+    return static_cast<int32_t>(workers_.size()) + 1;
+}
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) return;
+
+    Job job;
+    job.task = &task;
+    job.count = count;
+    job.errors.resize(count);
+
+    if (!workers_.empty() && count > 1) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(&job);
+        }
+        workAvailable_.notify_all();
+    }
+
+    for (size_t i = job.next++; i < count; i = job.next++) {
+        runTask(job, i);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = std::find(jobs_.begin(), jobs_.end(), &job);
+        if (it != jobs_.end()) {
+            jobs_.erase(it);
+        }
+        jobDone_.wait(lock, [&] { return job.done == job.count; });
+    }
+
+    for (const auto& error : job.errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void ThreadPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        workAvailable_.wait(lock, [&] { return stopping_ || !jobs_.empty(); });
+        if (jobs_.empty()) {
+            return;
+        }
+
+        Job* job = jobs_.front();
+        size_t index = job->next++;
+        if (index >= job->count) {
+            // Every index is taken, the owner waits for the ones still running
+            jobs_.pop_front();
+            continue;
+        }
+
+        lock.unlock();
+        runTask(*job, index);
+        lock.lock();
+    }
+}
+
+void ThreadPool::runTask(Job& job, size_t index) {
+    try {
+        (*job.task)(index);
+    }
+    catch (...) {
+        job.errors[index] = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (++job.done == job.count) {
+        jobDone_.notify_all();
+    }
+}
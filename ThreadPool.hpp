@@ -0,0 +1,52 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run indexed tasks. run() blocks, and the
+// calling thread works through the same job, so a task may call run() again
+// on the same pool without deadlocking.
+class ThreadPool {
+public:
+    // 0 uses one thread per hardware thread. A pool of 1 runs everything on the caller.
+    explicit ThreadPool(int32_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Runs task(0) .. task(count - 1) and waits for all of them. If any throw,
+    // the exception of the lowest index is rethrown once every task has finished.
+    void run(size_t count, const std::function<void(size_t)>& task);
+
+    // Threads that take part in run(), the caller included
+    int32_t size() const;
+
+private:
+    struct Job {
+        const std::function<void(size_t)>* task;
+        size_t count;
+        std::atomic<size_t> next{ 0 };
+        size_t done = 0;    // guarded by mutex_
+        std::vector<std::exception_ptr> errors;
+    };
+
+    void workerLoop();
+    void runTask(Job& job, size_t index);
+
+    std::vector<std::thread> workers_;
+    std::deque<Job*> jobs_;
+    std::mutex mutex_;
+    std::condition_variable workAvailable_;
+    std::condition_variable jobDone_;
+    bool stopping_ = false;
+};
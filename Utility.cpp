@@ -31,6 +31,37 @@ std::string bcOpName(BytecodeOp op) {
     case BC_POP: return "POP";
     case BC_CALL:return "CALL";
     case BC_RET: return "RET";
+    case BC_PUSHM:return "PUSHM";
+    case BC_POPM:return "POPM";
+    case BC_ENTER:return "ENTER";
+    case BC_LEAVE:return "LEAVE";
+    case BC_CMOVE:return "CMOVE";
+    case BC_CMOVNE:return "CMOVNE";
+    case BC_CMOVG:return "CMOVG";
+    case BC_CMOVL:return "CMOVL";
+    case BC_CMOVLE:return "CMOVLE";
+    case BC_CMOVGE:return "CMOVGE";
+    case BC_SETE:return "SETE";
+    case BC_SETNE:return "SETNE";
+    case BC_SETG:return "SETG";
+    case BC_SETL:return "SETL";
+    case BC_SETLE:return "SETLE";
+    case BC_SETGE:return "SETGE";
+    case BC_LOOP:return "LOOP";
+    case BC_VLOAD:return "VLOAD";
+    case BC_VSTORE:return "VSTORE";
+    case BC_VADD:return "VADD";
+    case BC_VSUB:return "VSUB";
+    case BC_VMUL:return "VMUL";
+    case BC_VAND:return "VAND";
+    case BC_VXOR:return "VXOR";
+    case BC_VCMPEQ:return "VCMPEQ";
+    case BC_VCMPGT:return "VCMPGT";
+    case BC_VSPLAT:return "VSPLAT";
+    case BC_VEXTRACT:return "VEXTRACT";
+    case BC_ALLOC:return "ALLOC";
+    case BC_FREE:return "FREE";
+    case BC_NATIVE:return "NATIVE";
     default:    return "UNKNOWN";
     }
 }
@@ -61,10 +92,56 @@ int32_t operandCountForOp(BytecodeOp op) {
     case BC_POP: return 1;
     case BC_CALL:return 1;
     case BC_RET: return 0;
+    case BC_PUSHM:return 1;
+    case BC_POPM:return 1;
+    case BC_ENTER:return 1;
+    case BC_LEAVE:return 0;
+    case BC_CMOVE:return 2;
+    case BC_CMOVNE:return 2;
+    case BC_CMOVG:return 2;
+    case BC_CMOVL:return 2;
+    case BC_CMOVLE:return 2;
+    case BC_CMOVGE:return 2;
+    case BC_SETE:return 1;
+    case BC_SETNE:return 1;
+    case BC_SETG:return 1;
+    case BC_SETL:return 1;
+    case BC_SETLE:return 1;
+    case BC_SETGE:return 1;
+    case BC_LOOP:return 2;
+    case BC_VLOAD:return 2;
+    case BC_VSTORE:return 2;
+    case BC_VADD:return 3;
+    case BC_VSUB:return 3;
+    case BC_VMUL:return 3;
+    case BC_VAND:return 3;
+    case BC_VXOR:return 3;
+    case BC_VCMPEQ:return 3;
+    case BC_VCMPGT:return 3;
+    case BC_VSPLAT:return 2;
+    case BC_VEXTRACT:return 3;
+    case BC_ALLOC:return 2;
+    case BC_FREE:return 1;
+    case BC_NATIVE:return 1;
     default:    return 0;
     }
 }
 
+static const char* const intrinsicNames[INTRINSIC_COUNT] = {
+    "__MEMCPY", "__SORT", "__HASH32", "__STRLEN"
+};
+
+int32_t intrinsicForSymbol(const std::string& name) {
+    for (int32_t i = 0; i < INTRINSIC_COUNT; i++) {
+        if (name == intrinsicNames[i]) return i;
+    }
+    return -1;
+}
+
+std::string intrinsicName(int32_t id) {
+    return id >= 0 && id < INTRINSIC_COUNT ? intrinsicNames[id] : "UNKNOWN";
+}
+
 int32_t readInt32(const std::vector<uint8_t>& bytecode, size_t index) {
     if (index + 4 > bytecode.size()) {
         throw std::out_of_range("Attempt to read beyond bytecode size: " + std::to_string(index));
@@ -75,6 +152,13 @@ int32_t readInt32(const std::vector<uint8_t>& bytecode, size_t index) {
         (static_cast<int32_t>(bytecode[index + 3]) << 24);
 }
 
+uint64_t hashBytes(std::string_view bytes, uint64_t hash) {
+    for (char c : bytes) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
 void printBytecode(const std::vector<uint8_t>& bytecode, size_t codeSize) {
     std::cout << "\n--- Bytecode Debug Output ---\n";
     std::cout << "Total bytecode size: " << bytecode.size() << " bytes\n";
@@ -102,6 +186,29 @@ void printBytecode(const std::vector<uint8_t>& bytecode, size_t codeSize) {
             int32_t val = readInt32(bytecode, ip);
             ip += 4;
 
+            if (type == 5) {
+                if (ip + 3 > bytecode.size()) {
+                    std::cout << " [Truncated]";
+                    break;
+                }
+                int32_t base = bytecode[ip], index = bytecode[ip + 1], scale = bytecode[ip + 2];
+                ip += 3;
+                std::cout << "  [type=5, disp=" << val << ", base=" << (base == 0xFF ? -1 : base)
+                    << ", index=" << (index == 0xFF ? -1 : index) << "*" << scale << "]";
+                continue;
+            }
+
+            if (type == 7) {
+                if (ip + 4 > bytecode.size()) {
+                    std::cout << " [Truncated]";
+                    break;
+                }
+                int64_t wide = (static_cast<int64_t>(readInt32(bytecode, ip)) << 32) | static_cast<uint32_t>(val);
+                ip += 4;
+                std::cout << "  [type=7, val=" << wide << "]";
+                continue;
+            }
+
             std::cout << "  [type=" << static_cast<int>(type) << ", val=" << val << "]";
         }
 
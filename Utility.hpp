@@ -3,12 +3,20 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cstdint>
 #include "BytecodeOp.hpp"
 
 std::string bcOpName(BytecodeOp op);
 int32_t operandCountForOp(BytecodeOp op);
+
+// Intrinsic bound to a (case-folded) symbol name, or -1 if the name is not reserved
+int32_t intrinsicForSymbol(const std::string& name);
+std::string intrinsicName(int32_t id);
 int32_t readInt32(const std::vector<uint8_t>& bytecode, size_t index);
 
+// 64-bit FNV-1a of bytes, continuing from hash to combine several inputs
+uint64_t hashBytes(std::string_view bytes, uint64_t hash = 14695981039346656037ull);
+
 void printBytecode(const std::vector<uint8_t>& bytecode, size_t codeSize);
@@ -1,73 +1,158 @@
 // Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
 
 #include "VM.hpp"
+#include "Profiler.hpp"
+#include "CacheSim.hpp"
+#include "Utility.hpp"
 #include <iostream>
 #include <string>
-    
-VM::VM(const std::vector<uint8_t>& memoryImage, std::size_t memSize, std::size_t stackSize, bool debug)
+#include <iomanip>
+#include <cstring>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define SLAM_SSE2 1
+#include <emmintrin.h>
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define SLAM_SSE41 1
+#include <smmintrin.h>
+#endif
+#endif
+
+VMCounters::VMCounters() {
+    for (auto& c : retired_) c.store(0, std::memory_order_relaxed);
+    loads_.store(0, std::memory_order_relaxed);
+    stores_.store(0, std::memory_order_relaxed);
+    calls_.store(0, std::memory_order_relaxed);
+    returns_.store(0, std::memory_order_relaxed);
+    branchesTaken_.store(0, std::memory_order_relaxed);
+    branchesNotTaken_.store(0, std::memory_order_relaxed);
+    stackHighWater_.store(0, std::memory_order_relaxed);
+}
+
+VMCounterSnapshot VMCounters::snapshot() const {
+    VMCounterSnapshot s;
+    for (int32_t i = 0; i < BC_OP_COUNT; i++) {
+        s.retired[i] = retired_[i].load(std::memory_order_relaxed);
+    }
+    s.loads = loads_.load(std::memory_order_relaxed);
+    s.stores = stores_.load(std::memory_order_relaxed);
+    s.calls = calls_.load(std::memory_order_relaxed);
+    s.returns = returns_.load(std::memory_order_relaxed);
+    s.branchesTaken = branchesTaken_.load(std::memory_order_relaxed);
+    s.branchesNotTaken = branchesNotTaken_.load(std::memory_order_relaxed);
+    s.stackHighWater = stackHighWater_.load(std::memory_order_relaxed);
+    return s;
+}
+
+uint64_t VMCounterSnapshot::instructionsRetired() const {
+    uint64_t total = 0;
+    for (int32_t i = 0; i < BC_OP_COUNT; i++) {
+        total += retired[i];
+    }
+    return total;
+}
+
+template<typename Word>
+BasicVM<Word>::BasicVM(const std::vector<uint8_t>& memoryImage, std::size_t memSize, std::size_t stackSize, bool debug)
     : memory_(memoryImage), stack_(stackSize, 0), debug_(debug)
 {
     memset(regs_, 0, sizeof(regs_));
+    memset(vregs_, 0, sizeof(vregs_));
 
     memory_.resize(memSize - memory_.size());
 
+    // ALLOC/FREE own the upper half of memory, the lower half stays free for
+    // programs that place their data at fixed addresses
+    heap_ = SlabAllocator(static_cast<int64_t>(std::max(memoryImage.size(), memory_.size() / 2)),
+        static_cast<int64_t>(memory_.size()));
+
     // R15 is the instruction pointer, always starts at 0
     regs_[15] = 0;
 
     // Initialize stack pointer (R14) at the end of the memory
-    regs_[14] = static_cast<int32_t>(stackSize);
+    regs_[14] = static_cast<Word>(stackSize);
+    stackLow_ = regs_[14];
 
     // Push a -1 return address as a sentinel to end the program
-    regs_[14] -= 4;
+    regs_[14] -= sizeof(Word);
     storeStack(regs_[14], -1);
 
     // Clear comparison flags
     flags_[0] = flags_[1] = flags_[2] = 0;
 }
 
-void VM::run() 
+template<typename Word>
+void BasicVM<Word>::run() 
 {
+    if (profiler_) {
+        profiler_->begin();
+    }
 
+    DecodedInstr d;
     while (true) {
-        int32_t curIp = regs_[15];
-        if (regs_[15] < 0 || static_cast<size_t>(regs_[15]) >= memory_.size()) {
-            throw std::runtime_error("Instruction pointer out of range");
+        decode(regs_[15], d);
+        curIp_ = d.ip;
+        regs_[15] = d.next;
+
+        if (d.op < BC_OP_COUNT) {
+            VMCounters::bump(counters_.retired_[d.op]);
+        }
+        if (profiler_) {
+            profiler_->onInstruction();
         }
-        uint8_t op = fetchByte();
-        int32_t operandCount = operandCountForOp(static_cast<BytecodeOp>(op));
 
         if (debug_)
-            std::cout << "Operand count: " << std::to_string(operandCount) << "\n";
+            std::cout << "Operand count: " << std::to_string(d.count) << "\n";
 
-        std::vector<uint8_t> types;
-        std::vector<int32_t> values;
-        for (int32_t i = 0; i < operandCount; i++) {
-            if (regs_[15] + 4 > memory_.size()) {
-                throw std::runtime_error("Operand fetch out of memory bounds");
-            }
-            uint8_t t = fetchByte();
-            int32_t v = fetchInt32();
-            types.push_back(t);
-            values.push_back(v);
+        if (execute(d)) {
+            break;
         }
+    }
 
-        if (debug_)
-        {
-            debugInstruction(curIp, static_cast<BytecodeOp>(op), types, values);
-        }
+    if (profiler_) {
+        profiler_->end();
+    }
+}
 
-        if (static_cast<BytecodeOp>(op) == BC_RET) {
-            if (opRetImpl()) {
-                break;
-            }
-        }
-        else {
-            execInstruction(static_cast<BytecodeOp>(op), types, values);
-        }
+template<typename Word>
+void BasicVM<Word>::setProfiler(Profiler* profiler) {
+    profiler_ = profiler;
+}
+
+template<typename Word>
+void BasicVM<Word>::setCacheSim(CacheSim* cacheSim) {
+    cacheSim_ = cacheSim;
+}
+
+template<typename Word>
+const SlabAllocator& BasicVM<Word>::heap() const {
+    return heap_;
+}
+
+template<typename Word>
+const VMCounters& BasicVM<Word>::counters() const {
+    return counters_;
+}
+
+template<typename Word>
+void BasicVM<Word>::printCounters() const {
+    VMCounterSnapshot s = counters_.snapshot();
+    std::cout << "VM counters:\n";
+    std::cout << "Instructions retired: " << s.instructionsRetired() << "\n";
+    for (int32_t i = 0; i < BC_OP_COUNT; i++) {
+        if (s.retired[i] == 0) continue;
+        std::cout << "  " << std::left << std::setw(8) << ::bcOpName(static_cast<BytecodeOp>(i))
+            << std::right << s.retired[i] << "\n";
     }
+    std::cout << "Loads: " << s.loads << ", stores: " << s.stores << "\n";
+    std::cout << "Calls: " << s.calls << ", returns: " << s.returns << "\n";
+    std::cout << "Branches taken: " << s.branchesTaken << ", not taken: " << s.branchesNotTaken << "\n";
+    std::cout << "Stack high-water mark: " << s.stackHighWater << " bytes\n";
 }
 
-void VM::printRegisters() {
+template<typename Word>
+void BasicVM<Word>::printRegisters() {
     std::cout << "Register values after execution:\n";
     for (int32_t i = 0; i < 16; i++) {
         std::cout << "R" << i << " = " << regs_[i] << "\n";
@@ -75,64 +160,219 @@ void VM::printRegisters() {
 }
 
 
-uint8_t VM::fetchByte() {
-    return memory_[regs_[15]++];
+template<typename Word>
+Word BasicVM<Word>::getRegister(int32_t index) const {
+    return regs_[index];
 }
 
+template<typename Word>
+void BasicVM<Word>::decode(Word ip, DecodedInstr& d) {
+    if (ip < 0 || ip > INT32_MAX || static_cast<size_t>(ip) >= memory_.size()) {
+        throw std::runtime_error("Instruction pointer out of range");
+    }
 
-int32_t VM::fetchInt32() {
-    int32_t v = 0;
-    for (int32_t i = 0; i < 4; i++) {
-        v |= ((int32_t)fetchByte()) << (i * 8);
+    size_t pc = static_cast<size_t>(ip);
+    d.ip = static_cast<int32_t>(ip);
+    d.op = static_cast<BytecodeOp>(memory_[pc++]);
+    d.count = operandCountForOp(d.op);
+
+    for (int32_t i = 0; i < d.count; i++) {
+        if (pc + 5 > memory_.size()) {
+            throw std::runtime_error("Operand fetch out of memory bounds");
+        }
+        d.types[i] = memory_[pc++];
+        int32_t v = 0;
+        for (int32_t b = 0; b < 4; b++) {
+            v |= ((int32_t)memory_[pc++]) << (b * 8);
+        }
+        d.vals[i] = v;
+
+        if (d.types[i] == 7) {
+            // imm64: the high half follows the low one
+            if (sizeof(Word) < 8) {
+                throw std::runtime_error("64-bit immediate in a 32-bit image");
+            }
+            if (pc + 4 > memory_.size()) {
+                throw std::runtime_error("Operand fetch out of memory bounds");
+            }
+            uint64_t hi = 0;
+            for (int32_t b = 0; b < 4; b++) {
+                hi |= static_cast<uint64_t>(memory_[pc++]) << (b * 8);
+            }
+            d.vals[i] = static_cast<Word>((hi << 32) | static_cast<uint32_t>(v));
+            d.types[i] = 0;
+        }
+
+        if (d.types[i] == 5) {
+            if (pc + 3 > memory_.size()) {
+                throw std::runtime_error("Operand fetch out of memory bounds");
+            }
+            for (int32_t b = 0; b < 3; b++) {
+                d.modes[i][b] = memory_[pc++];
+            }
+        }
     }
-    return v;
+
+    d.next = static_cast<int32_t>(pc);
 }
 
-void VM::checkMem(int32_t addr) {
-    if (addr < 0 || (size_t)(addr + 3) >= memory_.size()) {
+template<typename Word>
+void BasicVM<Word>::resolveOperands(const DecodedInstr& d, uint8_t* types, Word* vals) {
+    for (int32_t i = 0; i < d.count; i++) {
+        types[i] = d.types[i];
+        vals[i] = d.vals[i];
+        if (types[i] == 5) {
+            // Registers cannot change before the instruction executes, so the
+            // effective address is resolved up front and the operand becomes mem(imm)
+            vals[i] = effectiveAddress(vals[i], d.modes[i]);
+            types[i] = 2;
+        }
+    }
+}
+
+// Returns true when the program has finished
+template<typename Word>
+bool BasicVM<Word>::execute(const DecodedInstr& d) {
+    uint8_t types[3];
+    Word vals[3];
+    resolveOperands(d, types, vals);
+
+    if (debug_)
+    {
+        debugInstruction(d.ip, d.op, types, vals, d.count);
+    }
+
+    if (d.op == BC_RET || d.op == BC_NATIVE) {
+        if (d.op == BC_NATIVE) {
+            opNative(operandValue(types[0], vals[0]));
+        }
+        if (opRetImpl()) {
+            return true;
+        }
+        if (profiler_) {
+            profiler_->onReturn();
+        }
+    }
+    else {
+        execInstruction(d.op, types, vals);
+        if (profiler_ && d.op == BC_CALL) {
+            profiler_->onCall(static_cast<int32_t>(regs_[15]));
+        }
+    }
+    return false;
+}
+
+template<typename Word>
+Word BasicVM<Word>::effectiveAddress(Word disp, const uint8_t* mode) {
+    uint8_t base = mode[0];
+    uint8_t index = mode[1];
+    uint8_t scale = mode[2];
+    if ((base != 0xFF && base > 15) || (index != 0xFF && index > 15) ||
+        (scale != 1 && scale != 2 && scale != 4 && scale != 8)) {
+        throw std::runtime_error("Invalid addressing mode");
+    }
+
+    Word addr = disp;
+    if (base != 0xFF) addr += regs_[base];
+    if (index != 0xFF) addr += regs_[index] * scale;
+    return addr;
+}
+
+template<typename Word>
+void BasicVM<Word>::checkMem(Word addr, Word bytes) {
+    if (addr < 0 || bytes < 0 || static_cast<uint64_t>(addr) + static_cast<uint64_t>(bytes) > memory_.size()) {
         throw std::runtime_error("Memory out of range at address " + std::to_string(addr));
     }
 }
 
-int32_t VM::loadMem(int32_t addr) {
+template<typename Word>
+Word BasicVM<Word>::loadMem(Word addr) {
     checkMem(addr);
-    int32_t v = 0;
-    for (int32_t i = 0; i < 4; i++) {
-        v |= ((int32_t)memory_[addr + i]) << (i * 8);
+    VMCounters::bump(counters_.loads_);
+    if (cacheSim_) {
+        cacheSim_->accessMemory(curIp_, addr, sizeof(Word), false);
+    }
+    UWord v = 0;
+    for (size_t i = 0; i < sizeof(Word); i++) {
+        v |= static_cast<UWord>(memory_[addr + i]) << (i * 8);
     }
-    return v;
+    return static_cast<Word>(v);
 }
 
-void VM::storeMem(int32_t addr, int32_t val) {
+template<typename Word>
+void BasicVM<Word>::storeMem(Word addr, Word val) {
     checkMem(addr);
-    for (int32_t i = 0; i < 4; i++) {
-        memory_[addr + i] = (uint8_t)((val >> (i * 8)) & 0xFF);
+    if (addr < decodedLimit_) {
+        codeWritten_ = true;
+    }
+    VMCounters::bump(counters_.stores_);
+    if (cacheSim_) {
+        cacheSim_->accessMemory(curIp_, addr, sizeof(Word), true);
+    }
+    for (size_t i = 0; i < sizeof(Word); i++) {
+        memory_[addr + i] = (uint8_t)((static_cast<UWord>(val) >> (i * 8)) & 0xFF);
     }
 }
 
-void VM::checkStack(int32_t addr) {
-    if (addr < 0 || (size_t)(addr + 3) >= stack_.size()) {
+template<typename Word>
+void BasicVM<Word>::checkStack(Word addr, Word bytes) {
+    if (addr < 0 || bytes < 0 || static_cast<uint64_t>(addr) + static_cast<uint64_t>(bytes) > stack_.size()) {
         throw std::runtime_error("Stack out of range at address " + std::to_string(addr));
     }
 }
 
-int32_t VM::loadStack(int32_t addr) {
+template<typename Word>
+Word BasicVM<Word>::loadStack(Word addr) {
     checkStack(addr);
-    int32_t v = 0;
-    for (int32_t i = 0; i < 4; i++) {
-        v |= ((int32_t)stack_[addr + i]) << (i * 8);
+    if (cacheSim_) {
+        cacheSim_->accessStack(curIp_, addr, sizeof(Word), false);
+    }
+    UWord v = 0;
+    for (size_t i = 0; i < sizeof(Word); i++) {
+        v |= static_cast<UWord>(stack_[addr + i]) << (i * 8);
     }
-    return v;
+    return static_cast<Word>(v);
 }
 
-void VM::storeStack(int32_t addr, int32_t val) {
+template<typename Word>
+void BasicVM<Word>::storeStack(Word addr, Word val) {
     checkStack(addr);
-    for (int32_t i = 0; i < 4; i++) {
-        stack_[addr + i] = (uint8_t)((val >> (i * 8)) & 0xFF);
+    noteStackLow(addr);
+    if (cacheSim_) {
+        cacheSim_->accessStack(curIp_, addr, sizeof(Word), true);
+    }
+    for (size_t i = 0; i < sizeof(Word); i++) {
+        stack_[addr + i] = (uint8_t)((static_cast<UWord>(val) >> (i * 8)) & 0xFF);
+    }
+}
+
+template<typename Word>
+void BasicVM<Word>::noteStackLow(Word addr) {
+    if (addr < stackLow_) {
+        stackLow_ = addr;
+        counters_.stackHighWater_.store(stack_.size() - static_cast<size_t>(addr), std::memory_order_relaxed);
+    }
+}
+
+template<typename Word>
+Word BasicVM<Word>::memoryAddress(uint8_t type, Word val) {
+    switch (type) {
+    case 2: return val; // mem(imm)
+    case 3: return regs_[val]; // mem(reg)
+    default: throw std::runtime_error("Expected memory operand: " + std::to_string(type));
+    }
+}
+
+template<typename Word>
+int32_t* BasicVM<Word>::vectorReg(uint8_t type, Word val) {
+    if (type != 6 || val < 0 || val > 7) {
+        throw std::runtime_error("Expected vector register operand");
     }
+    return vregs_[val];
 }
 
-int32_t VM::operandValue(uint8_t type, int32_t val) {
+template<typename Word>
+Word BasicVM<Word>::operandValue(uint8_t type, Word val) {
     switch (type) {
     case 0: return val; // imm
     case 1: return regs_[val]; // reg
@@ -143,7 +383,8 @@ int32_t VM::operandValue(uint8_t type, int32_t val) {
     }
 }
 
-void VM::setOperandDest(uint8_t type, int32_t valDescriptor, int32_t value) {
+template<typename Word>
+void BasicVM<Word>::setOperandDest(uint8_t type, Word valDescriptor, Word value) {
     switch (type) {
     case 1: regs_[valDescriptor] = value; break; // reg
     case 2: storeMem(valDescriptor, value); break; // mem(imm)
@@ -154,146 +395,622 @@ void VM::setOperandDest(uint8_t type, int32_t valDescriptor, int32_t value) {
 }
 
 // Instruction execution methods
-void VM::execInstruction(BytecodeOp op, const std::vector<uint8_t>& types, const std::vector<int32_t>& vals)
+template<typename Word>
+void BasicVM<Word>::execInstruction(BytecodeOp op, const uint8_t* types, const Word* vals)
 {
     switch (op) {
-    case BC_MOV: binOp(&VM::opMov, types, vals); break;
-    case BC_ADD: triOp(&VM::opAddThree, types, vals); break;
-    case BC_SUB: triOp(&VM::opSubThree, types, vals); break;
-    case BC_MUL: triOp(&VM::opMulThree, types, vals); break;
-    case BC_DIV: triOp(&VM::opDivThree, types, vals); break;
-    case BC_AND: binOp(&VM::opAnd, types, vals); break;
-    case BC_OR:  binOp(&VM::opOr, types, vals); break;
-    case BC_XOR: binOp(&VM::opXor, types, vals); break;
-    case BC_SHL: binOp(&VM::opShl, types, vals); break;
-    case BC_SHR: binOp(&VM::opShr, types, vals); break;
-    case BC_CMP: binOp(&VM::opCmp, types, vals); break;
-    case BC_JMP: jumpOp(&VM::opJmp, types, vals); break;
-    case BC_JE:  jumpOp(&VM::opJe, types, vals); break;
-    case BC_JNE: jumpOp(&VM::opJne, types, vals); break;
-    case BC_JG:  jumpOp(&VM::opJg, types, vals); break;
-    case BC_JL:  jumpOp(&VM::opJl, types, vals); break;
-    case BC_JLE: jumpOp(&VM::opJle, types, vals); break;
-    case BC_JGE: jumpOp(&VM::opJge, types, vals); break;
-    case BC_LOAD:binOp(&VM::opLoad, types, vals); break;
-    case BC_STORE:binOp(&VM::opStore, types, vals); break;
-    case BC_PUSH: unaryOp(&VM::opPush, types, vals); break;
-    case BC_POP:  unaryOp(&VM::opPop, types, vals); break;
-    case BC_CALL: jumpOp(&VM::opCall, types, vals); break;
-        // BC_RET handled in run()
+    case BC_MOV: binOp(&BasicVM::opMov, types, vals); break;
+    case BC_ADD: triOp(&BasicVM::opAddThree, types, vals); break;
+    case BC_SUB: triOp(&BasicVM::opSubThree, types, vals); break;
+    case BC_MUL: triOp(&BasicVM::opMulThree, types, vals); break;
+    case BC_DIV: triOp(&BasicVM::opDivThree, types, vals); break;
+    case BC_AND: binOp(&BasicVM::opAnd, types, vals); break;
+    case BC_OR:  binOp(&BasicVM::opOr, types, vals); break;
+    case BC_XOR: binOp(&BasicVM::opXor, types, vals); break;
+    case BC_SHL: binOp(&BasicVM::opShl, types, vals); break;
+    case BC_SHR: binOp(&BasicVM::opShr, types, vals); break;
+    case BC_CMP: binOp(&BasicVM::opCmp, types, vals); break;
+    case BC_JMP: jumpOp(&BasicVM::opJmp, types, vals); break;
+    case BC_JE:  jumpOp(&BasicVM::opJe, types, vals); break;
+    case BC_JNE: jumpOp(&BasicVM::opJne, types, vals); break;
+    case BC_JG:  jumpOp(&BasicVM::opJg, types, vals); break;
+    case BC_JL:  jumpOp(&BasicVM::opJl, types, vals); break;
+    case BC_JLE: jumpOp(&BasicVM::opJle, types, vals); break;
+    case BC_JGE: jumpOp(&BasicVM::opJge, types, vals); break;
+    case BC_LOAD:binOp(&BasicVM::opLoad, types, vals); break;
+    case BC_STORE:binOp(&BasicVM::opStore, types, vals); break;
+    case BC_PUSH: unaryOp(&BasicVM::opPush, types, vals); break;
+    case BC_POP:  unaryOp(&BasicVM::opPop, types, vals); break;
+    case BC_CALL: jumpOp(&BasicVM::opCall, types, vals); break;
+    case BC_PUSHM: unaryOp(&BasicVM::opPushm, types, vals); break;
+    case BC_POPM:  unaryOp(&BasicVM::opPopm, types, vals); break;
+    case BC_ENTER: unaryOp(&BasicVM::opEnter, types, vals); break;
+    case BC_LEAVE: opLeave(); break;
+    case BC_LOOP: opLoop(types, vals); break;
+    case BC_VLOAD: case BC_VSTORE: case BC_VADD: case BC_VSUB: case BC_VMUL: case BC_VAND:
+    case BC_VXOR: case BC_VCMPEQ: case BC_VCMPGT: case BC_VSPLAT: case BC_VEXTRACT:
+        vectorOp(op, types, vals); break;
+    case BC_ALLOC: binOp(&BasicVM::opAlloc, types, vals); break;
+    case BC_FREE: unaryOp(&BasicVM::opFree, types, vals); break;
+    case BC_CMOVE: binOp(&BasicVM::opCmove, types, vals); break;
+    case BC_CMOVNE: binOp(&BasicVM::opCmovne, types, vals); break;
+    case BC_CMOVG: binOp(&BasicVM::opCmovg, types, vals); break;
+    case BC_CMOVL: binOp(&BasicVM::opCmovl, types, vals); break;
+    case BC_CMOVLE: binOp(&BasicVM::opCmovle, types, vals); break;
+    case BC_CMOVGE: binOp(&BasicVM::opCmovge, types, vals); break;
+    case BC_SETE: unaryOp(&BasicVM::opSete, types, vals); break;
+    case BC_SETNE: unaryOp(&BasicVM::opSetne, types, vals); break;
+    case BC_SETG: unaryOp(&BasicVM::opSetg, types, vals); break;
+    case BC_SETL: unaryOp(&BasicVM::opSetl, types, vals); break;
+    case BC_SETLE: unaryOp(&BasicVM::opSetle, types, vals); break;
+    case BC_SETGE: unaryOp(&BasicVM::opSetge, types, vals); break;
+        // BC_RET and BC_NATIVE handled in execute()
     default:
         throw std::runtime_error("Invalid opcode");
     }
 }
 
-void VM::binOp(void (VM::* f)(uint8_t, int32_t, int32_t), const std::vector<uint8_t>& t, const std::vector<int32_t>& v) {
+template<typename Word>
+void BasicVM<Word>::binOp(void (BasicVM::* f)(uint8_t, Word, Word), const uint8_t* t, const Word* v) {
     (this->*f)(t[0], v[0], operandValue(t[1], v[1]));
 }
 
-void VM::unaryOp(void (VM::* f)(uint8_t, int32_t), const std::vector<uint8_t>& t, const std::vector<int32_t>& v) {
+template<typename Word>
+void BasicVM<Word>::unaryOp(void (BasicVM::* f)(uint8_t, Word), const uint8_t* t, const Word* v) {
     (this->*f)(t[0], v[0]);
 }
 
-void VM::jumpOp(void (VM::* f)(int32_t), const std::vector<uint8_t>& t, const std::vector<int32_t>& v) {
-    (this->*f)(v[0]);
+template<typename Word>
+void BasicVM<Word>::jumpOp(void (BasicVM::* f)(Word), const uint8_t* t, const Word* v) {
+    // Direct targets are immediates, JMP reg and JMP [table+reg*4] read theirs
+    (this->*f)(operandValue(t[0], v[0]));
 }
 
-void VM::triOp(void (VM::* f)(uint8_t, int32_t, int32_t, int32_t),
-    const std::vector<uint8_t>& t, const std::vector<int32_t>& v) {
+template<typename Word>
+void BasicVM<Word>::triOp(void (BasicVM::* f)(uint8_t, Word, Word, Word),
+    const uint8_t* t, const Word* v) {
     // t[0] = destType, v[0] = destVal
     // t[1], v[1] = first source
     // t[2], v[2] = second source
-    int32_t src1 = operandValue(t[1], v[1]);
-    int32_t src2 = operandValue(t[2], v[2]);
+    Word src1 = operandValue(t[1], v[1]);
+    Word src2 = operandValue(t[2], v[2]);
     (this->*f)(t[0], v[0], src1, src2);
 }
 
-void VM::opAddThree(uint8_t dt, int32_t dv, int32_t src1, int32_t src2) {
+template<typename Word>
+void BasicVM<Word>::opAddThree(uint8_t dt, Word dv, Word src1, Word src2) {
     setOperandDest(dt, dv, src1 + src2);
 }
 
-void VM::opSubThree(uint8_t dt, int32_t dv, int32_t src1, int32_t src2) {
+template<typename Word>
+void BasicVM<Word>::opSubThree(uint8_t dt, Word dv, Word src1, Word src2) {
     setOperandDest(dt, dv, src1 - src2);
 }
 
-void VM::opMulThree(uint8_t dt, int32_t dv, int32_t src1, int32_t src2) {
+template<typename Word>
+void BasicVM<Word>::opMulThree(uint8_t dt, Word dv, Word src1, Word src2) {
     setOperandDest(dt, dv, src1 * src2);
 }
 
-void VM::opDivThree(uint8_t dt, int32_t dv, int32_t src1, int32_t src2) {
+template<typename Word>
+void BasicVM<Word>::opDivThree(uint8_t dt, Word dv, Word src1, Word src2) {
     setOperandDest(dt, dv, src1 / src2);
 }
 
 // Arithmetic ops:
-void VM::opMov(uint8_t dt, int32_t dv, int32_t sv) { setOperandDest(dt, dv, sv); }
-void VM::opAdd(uint8_t dt, int32_t dv, int32_t sv) { setOperandDest(dt, dv, operandValue(dt, dv) + sv); }
-void VM::opSub(uint8_t dt, int32_t dv, int32_t sv) { setOperandDest(dt, dv, operandValue(dt, dv) - sv); }
-void VM::opMul(uint8_t dt, int32_t dv, int32_t sv) { setOperandDest(dt, dv, operandValue(dt, dv) * sv); }
-void VM::opDiv(uint8_t dt, int32_t dv, int32_t sv) {
-    int32_t dval = operandValue(dt, dv);
+template<typename Word>
+void BasicVM<Word>::opMov(uint8_t dt, Word dv, Word sv) { setOperandDest(dt, dv, sv); }
+template<typename Word>
+void BasicVM<Word>::opAdd(uint8_t dt, Word dv, Word sv) { setOperandDest(dt, dv, operandValue(dt, dv) + sv); }
+template<typename Word>
+void BasicVM<Word>::opSub(uint8_t dt, Word dv, Word sv) { setOperandDest(dt, dv, operandValue(dt, dv) - sv); }
+template<typename Word>
+void BasicVM<Word>::opMul(uint8_t dt, Word dv, Word sv) { setOperandDest(dt, dv, operandValue(dt, dv) * sv); }
+template<typename Word>
+void BasicVM<Word>::opDiv(uint8_t dt, Word dv, Word sv) {
+    Word dval = operandValue(dt, dv);
     if (sv == 0) throw std::runtime_error("Division by zero");
     setOperandDest(dt, dv, dval / sv);
 }
-void VM::opAnd(uint8_t dt, int32_t dv, int32_t sv) { setOperandDest(dt, dv, operandValue(dt, dv) & sv); }
-void VM::opOr(uint8_t dt, int32_t dv, int32_t sv) { setOperandDest(dt, dv, operandValue(dt, dv) | sv); }
-void VM::opXor(uint8_t dt, int32_t dv, int32_t sv) { setOperandDest(dt, dv, operandValue(dt, dv) ^ sv); }
-void VM::opShl(uint8_t dt, int32_t dv, int32_t sv) { setOperandDest(dt, dv, operandValue(dt, dv) << sv); }
-void VM::opShr(uint8_t dt, int32_t dv, int32_t sv) {
-    uint32_t val = (uint32_t)operandValue(dt, dv);
-    setOperandDest(dt, dv, (int32_t)(val >> sv));
+template<typename Word>
+void BasicVM<Word>::opAnd(uint8_t dt, Word dv, Word sv) { setOperandDest(dt, dv, operandValue(dt, dv) & sv); }
+template<typename Word>
+void BasicVM<Word>::opOr(uint8_t dt, Word dv, Word sv) { setOperandDest(dt, dv, operandValue(dt, dv) | sv); }
+template<typename Word>
+void BasicVM<Word>::opXor(uint8_t dt, Word dv, Word sv) { setOperandDest(dt, dv, operandValue(dt, dv) ^ sv); }
+template<typename Word>
+void BasicVM<Word>::opShl(uint8_t dt, Word dv, Word sv) {
+    setOperandDest(dt, dv, static_cast<Word>(static_cast<UWord>(operandValue(dt, dv)) << (sv & (WORD_BITS - 1))));
+}
+template<typename Word>
+void BasicVM<Word>::opShr(uint8_t dt, Word dv, Word sv) {
+    UWord val = static_cast<UWord>(operandValue(dt, dv));
+    setOperandDest(dt, dv, static_cast<Word>(val >> (sv & (WORD_BITS - 1))));
 }
-void VM::opCmp(uint8_t dt, int32_t dv, int32_t sv) {
-    int32_t res = operandValue(dt, dv) - sv;
+template<typename Word>
+void BasicVM<Word>::opCmp(uint8_t dt, Word dv, Word sv) {
+    Word res = operandValue(dt, dv) - sv;
     flags_[0] = (res == 0) ? 1 : 0; // ZF
     flags_[1] = (res > 0) ? 1 : 0;  // GF
     flags_[2] = (res < 0) ? 1 : 0;  // LF
 }
 
-void VM::opLoad(uint8_t dt, int32_t dv, int32_t sv) { setOperandDest(dt, dv, sv); }
-void VM::opStore(uint8_t dt, int32_t dv, int32_t sv) { setOperandDest(dt, dv, sv); }
+template<typename Word>
+void BasicVM<Word>::opCmove(uint8_t dt, Word dv, Word sv) { if (flags_[0]) setOperandDest(dt, dv, sv); }
+template<typename Word>
+void BasicVM<Word>::opCmovne(uint8_t dt, Word dv, Word sv) { if (!flags_[0]) setOperandDest(dt, dv, sv); }
+template<typename Word>
+void BasicVM<Word>::opCmovg(uint8_t dt, Word dv, Word sv) { if (flags_[1]) setOperandDest(dt, dv, sv); }
+template<typename Word>
+void BasicVM<Word>::opCmovl(uint8_t dt, Word dv, Word sv) { if (flags_[2]) setOperandDest(dt, dv, sv); }
+template<typename Word>
+void BasicVM<Word>::opCmovle(uint8_t dt, Word dv, Word sv) { if (flags_[0] || flags_[2]) setOperandDest(dt, dv, sv); }
+template<typename Word>
+void BasicVM<Word>::opCmovge(uint8_t dt, Word dv, Word sv) { if (flags_[0] || flags_[1]) setOperandDest(dt, dv, sv); }
 
-void VM::opPush(uint8_t t, int32_t v) {
-    int32_t val = operandValue(t, v);
-    regs_[14] -= 4;
+template<typename Word>
+void BasicVM<Word>::opSete(uint8_t t, Word v) { setOperandDest(t, v, (flags_[0]) ? 1 : 0); }
+template<typename Word>
+void BasicVM<Word>::opSetne(uint8_t t, Word v) { setOperandDest(t, v, (!flags_[0]) ? 1 : 0); }
+template<typename Word>
+void BasicVM<Word>::opSetg(uint8_t t, Word v) { setOperandDest(t, v, (flags_[1]) ? 1 : 0); }
+template<typename Word>
+void BasicVM<Word>::opSetl(uint8_t t, Word v) { setOperandDest(t, v, (flags_[2]) ? 1 : 0); }
+template<typename Word>
+void BasicVM<Word>::opSetle(uint8_t t, Word v) { setOperandDest(t, v, (flags_[0] || flags_[2]) ? 1 : 0); }
+template<typename Word>
+void BasicVM<Word>::opSetge(uint8_t t, Word v) { setOperandDest(t, v, (flags_[0] || flags_[1]) ? 1 : 0); }
+
+template<typename Word>
+void BasicVM<Word>::opLoad(uint8_t dt, Word dv, Word sv) { setOperandDest(dt, dv, sv); }
+template<typename Word>
+void BasicVM<Word>::opStore(uint8_t dt, Word dv, Word sv) { setOperandDest(dt, dv, sv); }
+
+template<typename Word>
+void BasicVM<Word>::opPush(uint8_t t, Word v) {
+    Word val = operandValue(t, v);
+    regs_[14] -= sizeof(Word);
     storeStack(regs_[14], val);
 }
 
-void VM::opPop(uint8_t t, int32_t v) {
-    int32_t val = loadStack(regs_[14]);
-    regs_[14] += 4;
+template<typename Word>
+void BasicVM<Word>::opPop(uint8_t t, Word v) {
+    Word val = loadStack(regs_[14]);
+    regs_[14] += sizeof(Word);
     setOperandDest(t, v, val);
 }
 
+// PUSHM/POPM move the masked registers as one block, lowest register at the
+// lowest address. That is the same layout a PUSH sequence from the highest
+// register down would produce. The image is little-endian, as is every host we
+// build for, so a register array can be copied to and from the stack directly.
+template<typename Word>
+void BasicVM<Word>::opPushm(uint8_t t, Word v) {
+    Word mask = operandValue(t, v);
+    if (mask & ~0x3FFF) {
+        throw std::runtime_error("Invalid register mask for PUSHM: " + std::to_string(mask));
+    }
 
-void VM::opJmp(int32_t addr) { regs_[15] = addr; }
-void VM::opJe(int32_t addr) { if (flags_[0]) regs_[15] = addr; }
-void VM::opJne(int32_t addr) { if (!flags_[0]) regs_[15] = addr; }
-void VM::opJg(int32_t addr) { if (flags_[1]) regs_[15] = addr; }
-void VM::opJl(int32_t addr) { if (flags_[2]) regs_[15] = addr; }
-void VM::opJle(int32_t addr)
-{
-    if (flags_[0] || flags_[2]) { // ZF or LF
+    Word block[14];
+    int32_t count = 0;
+    for (int32_t r = 0; r < 14; r++) {
+        if (mask & (1 << r)) block[count++] = regs_[r];
+    }
 
-        regs_[15] = addr;
+    Word bytes = count * static_cast<Word>(sizeof(Word));
+    Word addr = regs_[14] - bytes;
+    checkStack(addr, bytes);
+    noteStackLow(addr);
+    if (cacheSim_) {
+        cacheSim_->accessStack(curIp_, addr, bytes, true);
     }
+    if (bytes > 0) {
+        memcpy(&stack_[addr], block, bytes);
+    }
+    regs_[14] = addr;
+}
+
+template<typename Word>
+void BasicVM<Word>::opPopm(uint8_t t, Word v) {
+    Word mask = operandValue(t, v);
+    if (mask & ~0x3FFF) {
+        throw std::runtime_error("Invalid register mask for POPM: " + std::to_string(mask));
+    }
+
+    int32_t count = 0;
+    for (int32_t r = 0; r < 14; r++) {
+        if (mask & (1 << r)) count++;
+    }
+
+    Word bytes = count * static_cast<Word>(sizeof(Word));
+    Word addr = regs_[14];
+    checkStack(addr, bytes);
+    if (cacheSim_) {
+        cacheSim_->accessStack(curIp_, addr, bytes, false);
+    }
+    Word block[14];
+    if (bytes > 0) {
+        memcpy(block, &stack_[addr], bytes);
+    }
+    count = 0;
+    for (int32_t r = 0; r < 14; r++) {
+        if (mask & (1 << r)) regs_[r] = block[count++];
+    }
+    regs_[14] = addr + bytes;
+}
+
+// ENTER n: push R13, R13 = frame base, reserve n bytes of locals. LEAVE undoes it.
+template<typename Word>
+void BasicVM<Word>::opEnter(uint8_t t, Word v) {
+    Word size = operandValue(t, v);
+    Word frame = regs_[14] - static_cast<Word>(sizeof(Word));
+    if (size < 0 || frame - size < 0) {
+        throw std::runtime_error("Stack overflow in ENTER");
+    }
+    storeStack(frame, regs_[13]);
+    regs_[13] = frame;
+    regs_[14] = frame - size;
+    noteStackLow(regs_[14]);
 }
 
-void VM::opJge(int32_t addr) {
-    if (flags_[0] || flags_[1]) { // ZF or GF
+template<typename Word>
+void BasicVM<Word>::opLeave() {
+    regs_[14] = regs_[13];
+    regs_[13] = loadStack(regs_[14]);
+    regs_[14] += sizeof(Word);
+}
+
+template<typename Word>
+void BasicVM<Word>::opJmp(Word addr) { regs_[15] = addr; }
+template<typename Word>
+void BasicVM<Word>::opJe(Word addr) { condJump(flags_[0], addr); }
+template<typename Word>
+void BasicVM<Word>::opJne(Word addr) { condJump(!flags_[0], addr); }
+template<typename Word>
+void BasicVM<Word>::opJg(Word addr) { condJump(flags_[1], addr); }
+template<typename Word>
+void BasicVM<Word>::opJl(Word addr) { condJump(flags_[2], addr); }
+template<typename Word>
+void BasicVM<Word>::opJle(Word addr) { condJump(flags_[0] || flags_[2], addr); } // ZF or LF
+template<typename Word>
+void BasicVM<Word>::opJge(Word addr) { condJump(flags_[0] || flags_[1], addr); } // ZF or GF
+
+template<typename Word>
+void BasicVM<Word>::condJump(bool taken, Word addr) {
+    if (taken) {
         regs_[15] = addr;
+        VMCounters::bump(counters_.branchesTaken_);
+    }
+    else {
+        VMCounters::bump(counters_.branchesNotTaken_);
     }
 }
-void VM::opCall(int32_t addr) {
-    int32_t retAddr = regs_[15];
-    regs_[14] -= 4;
+
+// LOOP rN, target: decrement rN and branch while it is non-zero. Flags are
+// left as CMP rN, 0 would set them, so LOOP can replace a cmp/jle/sub/jmp loop.
+template<typename Word>
+void BasicVM<Word>::opLoop(const uint8_t* types, const Word* vals) {
+    if (types[0] != 1) {
+        throw std::runtime_error("LOOP counter must be a register");
+    }
+    Word& counter = regs_[vals[0]];
+    Word target = vals[1];
+
+    counter--;
+    flags_[0] = (counter == 0) ? 1 : 0;
+    flags_[1] = (counter > 0) ? 1 : 0;
+    flags_[2] = (counter < 0) ? 1 : 0;
+    if (counter == 0) {
+        VMCounters::bump(counters_.branchesNotTaken_);
+        return;
+    }
+    VMCounters::bump(counters_.branchesTaken_);
+
+    // Backward loop over straight-line code: run the remaining iterations
+    // from the decoded block instead of dispatching through memory
+    if (target < curIp_ && !debug_ && !profiler_) {
+        const LoopBlock& block = loopBlock(static_cast<int32_t>(target), curIp_);
+        if (block.straightLine) {
+            runLoopBlock(block, counter, curIp_);
+            return;
+        }
+    }
+
+    regs_[15] = target;
+}
+
+template<typename Word>
+const typename BasicVM<Word>::LoopBlock& BasicVM<Word>::loopBlock(int32_t target, int32_t loopIp) {
+    if (codeWritten_) {
+        loopBlocks_.clear();
+        decodedLimit_ = 0;
+        codeWritten_ = false;
+    }
+
+    auto it = loopBlocks_.find(loopIp);
+    if (it != loopBlocks_.end()) {
+        return it->second;
+    }
+
+    LoopBlock& block = loopBlocks_[loopIp];
+    block.straightLine = true;
+    int32_t ip = target;
+    while (ip < loopIp) {
+        DecodedInstr d;
+        decode(ip, d);
+        switch (d.op) {
+        case BC_JMP: case BC_JE: case BC_JNE: case BC_JG: case BC_JL: case BC_JLE: case BC_JGE:
+        case BC_CALL: case BC_RET: case BC_LOOP: case BC_NATIVE:
+            block.straightLine = false;
+            break;
+        default:
+            if (d.op >= BC_OP_COUNT) block.straightLine = false;
+            break;
+        }
+        // Anything touching R15 directly is a jump in disguise
+        for (int32_t i = 0; i < d.count; i++) {
+            if (d.types[i] == 1 && d.vals[i] == 15) block.straightLine = false;
+        }
+        if (!block.straightLine) break;
+        block.body.push_back(d);
+        ip = d.next;
+    }
+
+    // The body must end exactly at the LOOP, otherwise target is not an instruction boundary
+    if (ip != loopIp) {
+        block.straightLine = false;
+    }
+    if (!block.straightLine) {
+        block.body.clear();
+    }
+    else {
+        // A store into the LOOP's operands changes the block as well
+        DecodedInstr loop;
+        decode(loopIp, loop);
+        if (loop.next > decodedLimit_) {
+            decodedLimit_ = loop.next;
+        }
+    }
+    return block;
+}
+
+template<typename Word>
+void BasicVM<Word>::runLoopBlock(const LoopBlock& block, Word& counter, int32_t loopIp) {
+    Word fallThrough = regs_[15];
+    uint8_t types[3];
+    Word vals[3];
+
+    while (true) {
+        for (const auto& d : block.body) {
+            curIp_ = d.ip;
+            regs_[15] = d.next;
+            VMCounters::bump(counters_.retired_[d.op]);
+            resolveOperands(d, types, vals);
+            execInstruction(d.op, types, vals);
+
+            // Guest wrote over decoded code: finish this iteration the slow way
+            if (codeWritten_) {
+                return;
+            }
+        }
+
+        curIp_ = loopIp;
+        VMCounters::bump(counters_.retired_[BC_LOOP]);
+        counter--;
+        flags_[0] = (counter == 0) ? 1 : 0;
+        flags_[1] = (counter > 0) ? 1 : 0;
+        flags_[2] = (counter < 0) ? 1 : 0;
+        if (counter == 0) {
+            VMCounters::bump(counters_.branchesNotTaken_);
+            break;
+        }
+        VMCounters::bump(counters_.branchesTaken_);
+    }
+
+    regs_[15] = fallThrough;
+}
+
+// Lane-wise ops on the 128-bit vector registers. Lanes are little-endian
+// int32, matching guest memory, so VLOAD/VSTORE are plain unaligned copies.
+template<typename Word>
+void BasicVM<Word>::vectorOp(BytecodeOp op, const uint8_t* t, const Word* v) {
+    if (op == BC_VLOAD || op == BC_VSTORE) {
+        bool isLoad = (op == BC_VLOAD);
+        Word addr = isLoad ? memoryAddress(t[1], v[1]) : memoryAddress(t[0], v[0]);
+        int32_t* reg = isLoad ? vectorReg(t[0], v[0]) : vectorReg(t[1], v[1]);
+        checkMem(addr, 16);
+        if (!isLoad && addr < decodedLimit_) {
+            codeWritten_ = true;
+        }
+        if (cacheSim_) {
+            cacheSim_->accessMemory(curIp_, addr, 16, !isLoad);
+        }
+        if (isLoad) {
+            VMCounters::bump(counters_.loads_);
+            memcpy(reg, &memory_[addr], 16);
+        }
+        else {
+            VMCounters::bump(counters_.stores_);
+            memcpy(&memory_[addr], reg, 16);
+        }
+        return;
+    }
+
+    if (op == BC_VSPLAT) {
+        int32_t* d = vectorReg(t[0], v[0]);
+        int32_t value = static_cast<int32_t>(operandValue(t[1], v[1]));
+        for (int32_t i = 0; i < 4; i++) d[i] = value;
+        return;
+    }
+
+    if (op == BC_VEXTRACT) {
+        const int32_t* a = vectorReg(t[1], v[1]);
+        Word lane = operandValue(t[2], v[2]);
+        if (lane < 0 || lane > 3) {
+            throw std::runtime_error("Vector lane out of range: " + std::to_string(lane));
+        }
+        setOperandDest(t[0], v[0], a[lane]);
+        return;
+    }
+
+    int32_t* d = vectorReg(t[0], v[0]);
+    const int32_t* a = vectorReg(t[1], v[1]);
+    const int32_t* b = vectorReg(t[2], v[2]);
+
+#if SLAM_SSE2
+    __m128i va = _mm_load_si128(reinterpret_cast<const __m128i*>(a));
+    __m128i vb = _mm_load_si128(reinterpret_cast<const __m128i*>(b));
+    __m128i r;
+    switch (op) {
+    case BC_VADD:   r = _mm_add_epi32(va, vb); break;
+    case BC_VSUB:   r = _mm_sub_epi32(va, vb); break;
+    case BC_VAND:   r = _mm_and_si128(va, vb); break;
+    case BC_VXOR:   r = _mm_xor_si128(va, vb); break;
+    case BC_VCMPEQ: r = _mm_cmpeq_epi32(va, vb); break;
+    case BC_VCMPGT: r = _mm_cmpgt_epi32(va, vb); break;
+    case BC_VMUL:
+#if SLAM_SSE41
+        r = _mm_mullo_epi32(va, vb);
+#else
+        {
+            // SSE2 has no 32-bit low multiply: multiply even and odd lanes as 64-bit, then interleave
+            __m128i even = _mm_mul_epu32(va, vb);
+            __m128i odd = _mm_mul_epu32(_mm_srli_epi64(va, 32), _mm_srli_epi64(vb, 32));
+            r = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+#endif
+        break;
+    default: throw std::runtime_error("Invalid vector opcode");
+    }
+    _mm_store_si128(reinterpret_cast<__m128i*>(d), r);
+#else
+    int32_t r[4];
+    for (int32_t i = 0; i < 4; i++) {
+        switch (op) {
+        case BC_VADD:   r[i] = static_cast<int32_t>(static_cast<uint32_t>(a[i]) + static_cast<uint32_t>(b[i])); break;
+        case BC_VSUB:   r[i] = static_cast<int32_t>(static_cast<uint32_t>(a[i]) - static_cast<uint32_t>(b[i])); break;
+        case BC_VMUL:   r[i] = static_cast<int32_t>(static_cast<uint32_t>(a[i]) * static_cast<uint32_t>(b[i])); break;
+        case BC_VAND:   r[i] = a[i] & b[i]; break;
+        case BC_VXOR:   r[i] = a[i] ^ b[i]; break;
+        case BC_VCMPEQ: r[i] = (a[i] == b[i]) ? -1 : 0; break;
+        case BC_VCMPGT: r[i] = (a[i] > b[i]) ? -1 : 0; break;
+        default: throw std::runtime_error("Invalid vector opcode");
+        }
+    }
+    memcpy(d, r, sizeof(r));
+#endif
+}
+
+// ALLOC dest, size hands out zero-filled heap memory, or 0 when the heap is
+// exhausted. FREE addr gives it back, FREE 0 does nothing.
+template<typename Word>
+void BasicVM<Word>::opAlloc(uint8_t dt, Word dv, Word sv) {
+    int64_t addr = heap_.allocate(sv);
+    if (addr != 0) {
+        memset(&memory_[static_cast<size_t>(addr)], 0, static_cast<size_t>(sv > 0 ? sv : 1));
+    }
+    setOperandDest(dt, dv, static_cast<Word>(addr));
+}
+
+template<typename Word>
+void BasicVM<Word>::opFree(uint8_t t, Word v) {
+    heap_.release(operandValue(t, v));
+}
+
+// Intrinsic stubs placed by the linker. Arguments arrive in R0-R2 and the
+// result goes to R0, other registers are left alone. The caller's return
+// address is popped by execute() as for RET.
+//   __memcpy(dest, src, bytes)  overlapping ranges are fine, returns dest
+//   __sort(addr, count)         sorts count signed words ascending in place
+//   __hash32(addr, bytes)       32-bit FNV-1a of the bytes
+//   __strlen(addr)              bytes before the first NUL
+template<typename Word>
+void BasicVM<Word>::opNative(Word id) {
+    switch (id) {
+    case INTRINSIC_MEMCPY: {
+        Word dest = regs_[0], src = regs_[1], bytes = regs_[2];
+        checkMem(src, bytes);
+        checkMem(dest, bytes);
+        if (dest < decodedLimit_ && bytes > 0) {
+            codeWritten_ = true;
+        }
+        if (cacheSim_ && bytes > 0) {
+            cacheSim_->accessMemory(curIp_, src, static_cast<uint32_t>(bytes), false);
+            cacheSim_->accessMemory(curIp_, dest, static_cast<uint32_t>(bytes), true);
+        }
+        memmove(&memory_[static_cast<size_t>(dest)], &memory_[static_cast<size_t>(src)], static_cast<size_t>(bytes));
+        break;
+    }
+    case INTRINSIC_SORT: {
+        Word addr = regs_[0], count = regs_[1];
+        if (count < 0 || count > static_cast<Word>(memory_.size() / sizeof(Word))) {
+            throw std::runtime_error("__sort count out of range: " + std::to_string(count));
+        }
+        Word bytes = count * static_cast<Word>(sizeof(Word));
+        checkMem(addr, bytes);
+        if (addr < decodedLimit_ && bytes > 0) {
+            codeWritten_ = true;
+        }
+        if (cacheSim_ && bytes > 0) {
+            cacheSim_->accessMemory(curIp_, addr, static_cast<uint32_t>(bytes), false);
+            cacheSim_->accessMemory(curIp_, addr, static_cast<uint32_t>(bytes), true);
+        }
+        // Guest words may be unaligned, sort a host copy
+        std::vector<Word> words(static_cast<size_t>(count));
+        memcpy(words.data(), &memory_[static_cast<size_t>(addr)], static_cast<size_t>(bytes));
+        std::sort(words.begin(), words.end());
+        memcpy(&memory_[static_cast<size_t>(addr)], words.data(), static_cast<size_t>(bytes));
+        break;
+    }
+    case INTRINSIC_HASH32: {
+        Word addr = regs_[0], bytes = regs_[1];
+        checkMem(addr, bytes);
+        if (cacheSim_ && bytes > 0) {
+            cacheSim_->accessMemory(curIp_, addr, static_cast<uint32_t>(bytes), false);
+        }
+        uint32_t hash = 2166136261u;
+        const uint8_t* p = memory_.data() + addr;
+        for (Word i = 0; i < bytes; i++) {
+            hash = (hash ^ p[i]) * 16777619u;
+        }
+        regs_[0] = static_cast<Word>(hash);
+        break;
+    }
+    case INTRINSIC_STRLEN: {
+        Word addr = regs_[0];
+        checkMem(addr, 0);
+        const uint8_t* start = memory_.data() + addr;
+        const void* nul = memchr(start, 0, memory_.size() - static_cast<size_t>(addr));
+        if (!nul) {
+            throw std::runtime_error("__strlen of unterminated string at address " + std::to_string(addr));
+        }
+        regs_[0] = static_cast<Word>(static_cast<const uint8_t*>(nul) - start);
+        if (cacheSim_) {
+            cacheSim_->accessMemory(curIp_, addr, static_cast<uint32_t>(regs_[0] + 1), false);
+        }
+        break;
+    }
+    default:
+        throw std::runtime_error("Invalid intrinsic: " + std::to_string(id));
+    }
+}
+
+template<typename Word>
+void BasicVM<Word>::opCall(Word addr) {
+    Word retAddr = regs_[15];
+    regs_[14] -= sizeof(Word);
     storeStack(regs_[14], retAddr);
     regs_[15] = addr;
+    VMCounters::bump(counters_.calls_);
 }
 
 // Instead of opRet, we have:
-bool VM::opRetImpl() {
-    int32_t retAddr = loadStack(regs_[14]);
-    regs_[14] += 4;
+template<typename Word>
+bool BasicVM<Word>::opRetImpl() {
+    Word retAddr = loadStack(regs_[14]);
+    regs_[14] += sizeof(Word);
+    VMCounters::bump(counters_.returns_);
     if (retAddr == -1) {
         // End program
         return true;
@@ -302,28 +1019,39 @@ bool VM::opRetImpl() {
     return false;
 }
 
-int32_t VM::operandCountForOp(BytecodeOp op) {
+template<typename Word>
+int32_t BasicVM<Word>::operandCountForOp(BytecodeOp op) {
     switch (op)
     {
     case BC_ADD: case BC_SUB: case BC_MUL: case BC_DIV:
+    case BC_VADD: case BC_VSUB: case BC_VMUL: case BC_VAND: case BC_VXOR:
+    case BC_VCMPEQ: case BC_VCMPGT: case BC_VEXTRACT:
         return 3;
     case BC_MOV:
     case BC_AND: case BC_OR: case BC_XOR: case BC_SHL: case BC_SHR:
     case BC_CMP: case BC_LOAD: case BC_STORE:
+    case BC_CMOVE: case BC_CMOVNE: case BC_CMOVG: case BC_CMOVL: case BC_CMOVLE: case BC_CMOVGE:
+    case BC_LOOP:
+    case BC_VLOAD: case BC_VSTORE: case BC_VSPLAT:
+    case BC_ALLOC:
         return 2;
     case BC_PUSH: case BC_POP:
+    case BC_PUSHM: case BC_POPM: case BC_ENTER:
+    case BC_SETE: case BC_SETNE: case BC_SETG: case BC_SETL: case BC_SETLE: case BC_SETGE:
     case BC_JMP: case BC_JE: case BC_JNE: case BC_JG: case BC_JL:
     case BC_JLE: case BC_JGE:
     case BC_CALL:
+    case BC_FREE: case BC_NATIVE:
         return 1;
-    case BC_RET:
+    case BC_RET: case BC_LEAVE:
         return 0;
     default:
         return 0;
     }
 }
 
-std::string VM::bcOpName(BytecodeOp op) {
+template<typename Word>
+std::string BasicVM<Word>::bcOpName(BytecodeOp op) {
     switch (op) {
     case BC_MOV:return "MOV";
     case BC_ADD:return "ADD";
@@ -349,14 +1077,46 @@ std::string VM::bcOpName(BytecodeOp op) {
     case BC_POP:return "POP";
     case BC_CALL:return "CALL";
     case BC_RET:return "RET";
+    case BC_PUSHM:return "PUSHM";
+    case BC_POPM:return "POPM";
+    case BC_ENTER:return "ENTER";
+    case BC_LEAVE:return "LEAVE";
+    case BC_CMOVE:return "CMOVE";
+    case BC_CMOVNE:return "CMOVNE";
+    case BC_CMOVG:return "CMOVG";
+    case BC_CMOVL:return "CMOVL";
+    case BC_CMOVLE:return "CMOVLE";
+    case BC_CMOVGE:return "CMOVGE";
+    case BC_SETE:return "SETE";
+    case BC_SETNE:return "SETNE";
+    case BC_SETG:return "SETG";
+    case BC_SETL:return "SETL";
+    case BC_SETLE:return "SETLE";
+    case BC_SETGE:return "SETGE";
+    case BC_LOOP:return "LOOP";
+    case BC_VLOAD:return "VLOAD";
+    case BC_VSTORE:return "VSTORE";
+    case BC_VADD:return "VADD";
+    case BC_VSUB:return "VSUB";
+    case BC_VMUL:return "VMUL";
+    case BC_VAND:return "VAND";
+    case BC_VXOR:return "VXOR";
+    case BC_VCMPEQ:return "VCMPEQ";
+    case BC_VCMPGT:return "VCMPGT";
+    case BC_VSPLAT:return "VSPLAT";
+    case BC_VEXTRACT:return "VEXTRACT";
+    case BC_ALLOC:return "ALLOC";
+    case BC_FREE:return "FREE";
+    case BC_NATIVE:return "NATIVE";
     default:return "UNKNOWN";
     }
 }
 
-void VM::debugInstruction(int32_t ip, BytecodeOp op, const std::vector<uint8_t>& types, const std::vector<int32_t>& vals) {
+template<typename Word>
+void BasicVM<Word>::debugInstruction(int32_t ip, BytecodeOp op, const uint8_t* types, const Word* vals, int32_t count) {
     std::cout << "Executing at IP=0x" << std::hex << ip << std::dec << ": " << bcOpName(op);
 
-    for (size_t i = 0; i < types.size(); i++) {
+    for (int32_t i = 0; i < count; i++) {
         std::cout << " ";
         printOperand(types[i], vals[i]);
     }
@@ -364,8 +1124,9 @@ void VM::debugInstruction(int32_t ip, BytecodeOp op, const std::vector<uint8_t>&
     std::cout << "\n";
 }
 
-void VM::printOperand(uint8_t t, int32_t v) {
-    int32_t mem = 0;
+template<typename Word>
+void BasicVM<Word>::printOperand(uint8_t t, Word v) {
+    Word mem = 0;
 
     if (t == 2)
     {
@@ -378,6 +1139,11 @@ void VM::printOperand(uint8_t t, int32_t v) {
     case 2: std::cout << "mem(" << v << ")=" << mem; break;
     case 3: std::cout << "mem(R" << v << ")"; break;
     case 4: std::cout << "labelAddr(" << v << ")"; break;
+    case 6: std::cout << "vreg(V" << v << ")=[" << vregs_[v][0] << "," << vregs_[v][1]
+        << "," << vregs_[v][2] << "," << vregs_[v][3] << "]"; break;
     default: std::cout << "invalid_type(" << (int32_t)t << ")";
     }
 }
+
+template class BasicVM<int32_t>;
+template class BasicVM<int64_t>;
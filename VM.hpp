@@ -2,81 +2,216 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
+#include <string>
 #include "BytecodeOp.hpp"
+#include "SlabAllocator.hpp"
 #include <stdexcept>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+// Plain copy of the VM counters, see VMCounters::snapshot()
+struct VMCounterSnapshot {
+    uint64_t retired[BC_OP_COUNT];  // instructions retired per opcode
+    uint64_t loads;                 // guest memory reads
+    uint64_t stores;                // guest memory writes
+    uint64_t calls;
+    uint64_t returns;
+    uint64_t branchesTaken;         // conditional jumps only
+    uint64_t branchesNotTaken;
+    uint64_t stackHighWater;        // deepest stack use, in bytes
+
+    uint64_t instructionsRetired() const;
+};
+
+// Always-on counter block. Only the thread running the VM writes it, so every
+// update is a relaxed load + store (no locked instructions) and any other
+// thread may poll snapshot() while the VM runs. Individual counters are exact,
+// a snapshot taken mid-run is not a single consistent cut across all of them.
+template<typename Word> class BasicVM;
+
+class VMCounters {
+public:
+    VMCounters();
+
+    VMCounterSnapshot snapshot() const;
 
-class VM {
+private:
+    template<typename Word> friend class BasicVM;
+
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> retired_[BC_OP_COUNT];
+    std::atomic<uint64_t> loads_;
+    std::atomic<uint64_t> stores_;
+    std::atomic<uint64_t> calls_;
+    std::atomic<uint64_t> returns_;
+    std::atomic<uint64_t> branchesTaken_;
+    std::atomic<uint64_t> branchesNotTaken_;
+    std::atomic<uint64_t> stackHighWater_;
+};
+
+class Profiler;
+class CacheSim;
+
+// Word is the register width: int32_t for 32-bit images, int64_t for images
+// assembled with ".bits 64". Registers, addresses, stack slots and LOAD/STORE
+// are all Word wide, vector lanes stay int32 in both modes.
+template<typename Word>
+class BasicVM {
 public:
     // 1MB memory model with 64kb stack
-    VM(const std::vector<uint8_t>& memoryImage, std::size_t memSize = 1048576, std::size_t stackSize = 65536, bool debug = false);
+    BasicVM(const std::vector<uint8_t>& memoryImage, std::size_t memSize = 1048576, std::size_t stackSize = 65536, bool debug = false);
 
     void run();
 
     void printRegisters();
 
+    // Value of Rn once run() returns
+    Word getRegister(int32_t index) const;
+
+    // Attach a call-graph profiler, or nullptr to detach. Not owned.
+    void setProfiler(Profiler* profiler);
+
+    // Feed every guest memory and stack access into a cache model, or nullptr to detach. Not owned.
+    void setCacheSim(CacheSim* cacheSim);
+
+    // ALLOC/FREE heap, for usage and fragmentation stats
+    const SlabAllocator& heap() const;
+
+    // Safe to read from another thread while run() executes
+    const VMCounters& counters() const;
+    void printCounters() const;
+
 private:
-    int32_t regs_[16]; // R0-R15
+    using UWord = std::make_unsigned_t<Word>;
+    static constexpr Word WORD_BITS = sizeof(Word) * 8;
+
+    Word regs_[16]; // R0-R15
+    alignas(16) int32_t vregs_[8][4]; // V0-V7, four int32 lanes each
     std::vector<uint8_t> memory_;
     std::vector<uint8_t> stack_;
     int32_t flags_[3]; // 0=ZF, 1=GF, 2=LF
     bool debug_ = false;
-
-    uint8_t fetchByte();
-    int32_t fetchInt32();
-
-    void checkMem(int32_t addr);
-    int32_t loadMem(int32_t addr);
-    void storeMem(int32_t addr, int32_t val);
-    void checkStack(int32_t addr);
-    int32_t loadStack(int32_t addr);
-    void storeStack(int32_t addr, int32_t val);
-
-    int32_t operandValue(uint8_t type, int32_t val);
-    void setOperandDest(uint8_t type, int32_t valDescriptor, int32_t value);
+    Profiler* profiler_ = nullptr;
+    CacheSim* cacheSim_ = nullptr;
+    int32_t curIp_ = 0; // address of the instruction being executed, code always lives below 2 GB
+    Word stackLow_;     // lowest stack address written so far
+    VMCounters counters_;
+    SlabAllocator heap_;
+
+    // One instruction decoded from memory_, operands still in encoded form
+    struct DecodedInstr {
+        BytecodeOp op;
+        int32_t count;
+        uint8_t types[3];
+        Word vals[3];
+        uint8_t modes[3][3]; // base, index, scale of type 5 operands
+        int32_t ip;
+        int32_t next;
+    };
+
+    // A LOOP whose body is one straight-line run of decoded instructions
+    struct LoopBlock {
+        bool straightLine;
+        std::vector<DecodedInstr> body;
+    };
+
+    std::unordered_map<int32_t, LoopBlock> loopBlocks_; // keyed by address of the LOOP
+    int32_t decodedLimit_ = 0;  // end of the highest decoded loop block
+    bool codeWritten_ = false;  // guest stored below decodedLimit_, blocks are stale
+
+    void decode(Word ip, DecodedInstr& d);
+    bool execute(const DecodedInstr& d);
+    void resolveOperands(const DecodedInstr& d, uint8_t* types, Word* vals);
+    Word effectiveAddress(Word disp, const uint8_t* mode);
+
+    void checkMem(Word addr, Word bytes = sizeof(Word));
+    Word loadMem(Word addr);
+    void storeMem(Word addr, Word val);
+    void checkStack(Word addr, Word bytes = sizeof(Word));
+    Word loadStack(Word addr);
+    void storeStack(Word addr, Word val);
+    void noteStackLow(Word addr);
+
+    Word memoryAddress(uint8_t type, Word val);
+    int32_t* vectorReg(uint8_t type, Word val);
+
+    Word operandValue(uint8_t type, Word val);
+    void setOperandDest(uint8_t type, Word valDescriptor, Word value);
 
     // Instruction execution methods
-    void execInstruction(BytecodeOp op, const std::vector<uint8_t>& types, const std::vector<int32_t>& vals);
+    void execInstruction(BytecodeOp op, const uint8_t* types, const Word* vals);
 
-    void binOp(void (VM::* f)(uint8_t, int32_t, int32_t), const std::vector<uint8_t>& t, const std::vector<int32_t>& v);
-    void unaryOp(void (VM::* f)(uint8_t, int32_t), const std::vector<uint8_t>& t, const std::vector<int32_t>& v);
-    void jumpOp(void (VM::* f)(int32_t), const std::vector<uint8_t>& t, const std::vector<int32_t>& v);
-    void triOp(void (VM::* f)(uint8_t, int32_t, int32_t, int32_t),
-        const std::vector<uint8_t>& t, const std::vector<int32_t>& v);
+    void binOp(void (BasicVM::* f)(uint8_t, Word, Word), const uint8_t* t, const Word* v);
+    void unaryOp(void (BasicVM::* f)(uint8_t, Word), const uint8_t* t, const Word* v);
+    void jumpOp(void (BasicVM::* f)(Word), const uint8_t* t, const Word* v);
+    void triOp(void (BasicVM::* f)(uint8_t, Word, Word, Word),
+        const uint8_t* t, const Word* v);
 
-    void opAddThree(uint8_t dt, int32_t dv, int32_t src1, int32_t src2);
-    void opSubThree(uint8_t dt, int32_t dv, int32_t src1, int32_t src2);
-    void opMulThree(uint8_t dt, int32_t dv, int32_t src1, int32_t src2);
-    void opDivThree(uint8_t dt, int32_t dv, int32_t src1, int32_t src2);
+    void opAddThree(uint8_t dt, Word dv, Word src1, Word src2);
+    void opSubThree(uint8_t dt, Word dv, Word src1, Word src2);
+    void opMulThree(uint8_t dt, Word dv, Word src1, Word src2);
+    void opDivThree(uint8_t dt, Word dv, Word src1, Word src2);
 
     // Arithmetic ops:
-    void opMov(uint8_t dt, int32_t dv, int32_t sv);
-    void opAdd(uint8_t dt, int32_t dv, int32_t sv);
-    void opSub(uint8_t dt, int32_t dv, int32_t sv);
-    void opMul(uint8_t dt, int32_t dv, int32_t sv);
-    void opDiv(uint8_t dt, int32_t dv, int32_t sv);
-    void opAnd(uint8_t dt, int32_t dv, int32_t sv);
-    void opOr(uint8_t dt, int32_t dv, int32_t sv);
-    void opXor(uint8_t dt, int32_t dv, int32_t sv);
-    void opShl(uint8_t dt, int32_t dv, int32_t sv);
-    void opShr(uint8_t dt, int32_t dv, int32_t sv);
-    void opCmp(uint8_t dt, int32_t dv, int32_t sv);
-
-    void opLoad(uint8_t dt, int32_t dv, int32_t sv);
-    void opStore(uint8_t dt, int32_t dv, int32_t sv);
-
-    void opPush(uint8_t t, int32_t v);
-    void opPop(uint8_t t, int32_t v);
-
-
-    void opJmp(int32_t addr);
-    void opJe(int32_t addr);
-    void opJne(int32_t addr);
-    void opJg(int32_t addr);
-    void opJl(int32_t addr);
-    void opJle(int32_t addr);
-
-    void opJge(int32_t addr);
-    void opCall(int32_t addr);
+    void opMov(uint8_t dt, Word dv, Word sv);
+    void opAdd(uint8_t dt, Word dv, Word sv);
+    void opSub(uint8_t dt, Word dv, Word sv);
+    void opMul(uint8_t dt, Word dv, Word sv);
+    void opDiv(uint8_t dt, Word dv, Word sv);
+    void opAnd(uint8_t dt, Word dv, Word sv);
+    void opOr(uint8_t dt, Word dv, Word sv);
+    void opXor(uint8_t dt, Word dv, Word sv);
+    void opShl(uint8_t dt, Word dv, Word sv);
+    void opShr(uint8_t dt, Word dv, Word sv);
+    void opCmp(uint8_t dt, Word dv, Word sv);
+
+    // Conditional moves and SETcc read the flags left by CMP
+    void opCmove(uint8_t dt, Word dv, Word sv);
+    void opCmovne(uint8_t dt, Word dv, Word sv);
+    void opCmovg(uint8_t dt, Word dv, Word sv);
+    void opCmovl(uint8_t dt, Word dv, Word sv);
+    void opCmovle(uint8_t dt, Word dv, Word sv);
+    void opCmovge(uint8_t dt, Word dv, Word sv);
+    void opSete(uint8_t t, Word v);
+    void opSetne(uint8_t t, Word v);
+    void opSetg(uint8_t t, Word v);
+    void opSetl(uint8_t t, Word v);
+    void opSetle(uint8_t t, Word v);
+    void opSetge(uint8_t t, Word v);
+
+    void opLoad(uint8_t dt, Word dv, Word sv);
+    void opStore(uint8_t dt, Word dv, Word sv);
+
+    void opPush(uint8_t t, Word v);
+    void opPop(uint8_t t, Word v);
+    void opPushm(uint8_t t, Word v);
+    void opPopm(uint8_t t, Word v);
+    void opEnter(uint8_t t, Word v);
+    void opLeave();
+    void opAlloc(uint8_t dt, Word dv, Word sv);
+    void opFree(uint8_t t, Word v);
+    void opNative(Word id);
+
+
+    void opJmp(Word addr);
+    void opJe(Word addr);
+    void opJne(Word addr);
+    void opJg(Word addr);
+    void opJl(Word addr);
+    void opJle(Word addr);
+
+    void opJge(Word addr);
+    void condJump(bool taken, Word addr);
+    void opLoop(const uint8_t* types, const Word* vals);
+    void vectorOp(BytecodeOp op, const uint8_t* t, const Word* v);
+    const LoopBlock& loopBlock(int32_t target, int32_t loopIp);
+    void runLoopBlock(const LoopBlock& block, Word& counter, int32_t loopIp);
+    void opCall(Word addr);
 
     // Instead of opRet, we have:
     bool opRetImpl();
@@ -84,6 +219,9 @@ private:
     int operandCountForOp(BytecodeOp op);
     std::string bcOpName(BytecodeOp op);
 
-    void debugInstruction(int32_t ip, BytecodeOp op, const std::vector<uint8_t>& types, const std::vector<int32_t>& vals);
-    void printOperand(uint8_t t, int32_t v);
-};
\ No newline at end of file
+    void debugInstruction(int32_t ip, BytecodeOp op, const uint8_t* types, const Word* vals, int32_t count);
+    void printOperand(uint8_t t, Word v);
+};
+
+using VM = BasicVM<int32_t>;
+using VM64 = BasicVM<int64_t>;
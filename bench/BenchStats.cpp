@@ -0,0 +1,39 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#include "BenchStats.hpp"
+#include <algorithm>
+#include <cmath>
+
+// Two-sided 95% Student t for df = 1..30, normal beyond
+static double tCritical(int32_t df) {
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (df < 1) return 0.0;
+    return df <= 30 ? table[df - 1] : 1.960;
+}
+
+SampleStats sampleStats(std::vector<double> values) {
+    SampleStats s;
+    s.samples = static_cast<int32_t>(values.size());
+    if (values.empty()) return s;
+
+    double sum = 0;
+    for (double v : values) sum += v;
+    s.mean = sum / values.size();
+
+    double sq = 0;
+    for (double v : values) sq += (v - s.mean) * (v - s.mean);
+    s.stddev = values.size() > 1 ? std::sqrt(sq / (values.size() - 1)) : 0.0;
+
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    s.median = values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+
+    double half = tCritical(s.samples - 1) * s.stddev / std::sqrt(static_cast<double>(s.samples));
+    s.ciLow = s.mean - half;
+    s.ciHigh = s.mean + half;
+    return s;
+}
@@ -0,0 +1,18 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// Summary of repeated timing samples, shared by the benchmark executables
+struct SampleStats {
+    double mean = 0;
+    double median = 0;
+    double stddev = 0;
+    double ciLow = 0;   // 95% confidence interval of the mean, Student t
+    double ciHigh = 0;
+    int32_t samples = 0;
+};
+
+SampleStats sampleStats(std::vector<double> values);
@@ -0,0 +1,174 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#include "ProgramGenerator.hpp"
+#include <sstream>
+#include <stdexcept>
+
+static const int32_t DATA_ARRAY_WORDS = 16;
+static const int32_t LINES_PER_FUNCTION = 200;
+
+ProgramGenerator::ProgramGenerator(const GeneratorConfig& config)
+    : config_(config) {
+    if (config_.lines < 1 || config_.objects < 1 || config_.dataWords < DATA_ARRAY_WORDS) {
+        throw std::runtime_error("Generator needs at least 1 line, 1 object and 16 data words");
+    }
+    if (config_.mixAlu + config_.mixMem + config_.mixBranch + config_.mixCall + config_.mixVector <= 0) {
+        throw std::runtime_error("Generator instruction mix is empty");
+    }
+}
+
+void ProgramGenerator::parseMix(const std::string& mix, GeneratorConfig& config) {
+    std::istringstream in(mix);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            throw std::runtime_error("Bad mix entry: " + item);
+        }
+        std::string key = item.substr(0, eq);
+        int32_t weight = std::stoi(item.substr(eq + 1));
+        if (key == "alu") config.mixAlu = weight;
+        else if (key == "mem") config.mixMem = weight;
+        else if (key == "branch") config.mixBranch = weight;
+        else if (key == "call") config.mixCall = weight;
+        else if (key == "vector") config.mixVector = weight;
+        else throw std::runtime_error("Unknown mix key: " + key);
+    }
+}
+
+int32_t ProgramGenerator::functionCount() const {
+    return config_.lines / LINES_PER_FUNCTION + 1;
+}
+
+int32_t ProgramGenerator::pick(int32_t count) {
+    return static_cast<int32_t>(rng_() % static_cast<uint32_t>(count));
+}
+
+bool ProgramGenerator::chance(double p) {
+    return std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < p;
+}
+
+// R13-R15 are left alone, they are the frame, stack and instruction pointers
+std::string ProgramGenerator::reg() {
+    return "r" + std::to_string(pick(13));
+}
+
+std::string ProgramGenerator::aluLine() {
+    static const char* const three[] = { "add", "sub", "mul" };
+    static const char* const two[] = { "and", "or", "xor", "shl", "shr", "mov" };
+    switch (pick(4)) {
+    case 0: return std::string(three[pick(3)]) + " " + reg() + ", " + reg() + ", " + reg();
+    case 1: return std::string(three[pick(3)]) + " " + reg() + ", " + reg() + ", " + std::to_string(pick(1000));
+    case 2: return std::string(two[pick(6)]) + " " + reg() + ", " + reg();
+    default: return std::string(two[pick(6)]) + " " + reg() + ", " + std::to_string(pick(100000));
+    }
+}
+
+std::string ProgramGenerator::memLine(int32_t object) {
+    std::string array = "d" + std::to_string(object) + "_" + std::to_string(pick(config_.dataWords / DATA_ARRAY_WORDS));
+    std::string offset = std::to_string(pick(DATA_ARRAY_WORDS / 2) * 4);
+    switch (pick(4)) {
+    case 0: return "load " + reg() + ", [" + array + "+" + offset + "]";
+    case 1: return "store [" + array + "+" + offset + "], " + reg();
+    case 2: return "mov " + reg() + ", [" + reg() + " + " + reg() + "*4 + " + offset + "]";
+    default: return "mov [" + array + "], " + std::to_string(pick(1000));
+    }
+}
+
+std::string ProgramGenerator::vectorLine(int32_t object) {
+    static const char* const ops[] = { "vadd", "vsub", "vmul", "vand", "vxor", "vcmpeq", "vcmpgt" };
+    std::string array = "d" + std::to_string(object) + "_" + std::to_string(pick(config_.dataWords / DATA_ARRAY_WORDS));
+    auto vreg = [&]() { return "v" + std::to_string(pick(8)); };
+    switch (pick(3)) {
+    case 0: return "vload " + vreg() + ", [" + array + "]";
+    case 1: return "vstore [" + array + "], " + vreg();
+    default: return std::string(ops[pick(7)]) + " " + vreg() + ", " + vreg() + ", " + vreg();
+    }
+}
+
+std::string ProgramGenerator::generate(int32_t object) {
+    rng_.seed(config_.seed * 7919u + static_cast<uint32_t>(object));
+    std::ostringstream out;
+    std::string prefix = "o" + std::to_string(object) + "_";
+
+    auto comment = [&]() -> std::string {
+        return chance(config_.commentDensity) ? "    ; generated line, nothing to see" : "";
+    };
+
+    if (config_.bits == 64) {
+        out << ".bits 64\n";
+    }
+
+    out << ".data\n";
+    for (int32_t a = 0; a < config_.dataWords / DATA_ARRAY_WORDS; a++) {
+        out << "d" << object << "_" << a << ": .word ";
+        for (int32_t w = 0; w < DATA_ARRAY_WORDS; w++) {
+            out << (w ? ", " : "") << pick(100000);
+        }
+        out << comment() << "\n";
+    }
+
+    // Decide where labels go first, so branches can target any of them
+    std::vector<bool> labelAt(config_.lines);
+    int32_t labels = 0;
+    for (int32_t i = 0; i < config_.lines; i++) {
+        labelAt[i] = chance(config_.labelDensity);
+        if (labelAt[i]) labels++;
+    }
+
+    const int32_t functions = functionCount();
+    const int32_t total = config_.mixAlu + config_.mixMem + config_.mixBranch + config_.mixCall + config_.mixVector;
+    static const char* const jumps[] = { "jmp", "je", "jne", "jg", "jl", "jle", "jge" };
+
+    out << ".code\n";
+    if (object == 0) {
+        out << "main:\n    call o0_f0\n    ret\n";
+    }
+
+    int32_t label = 0;
+    int32_t function = 0;
+    int32_t line = 0;
+    while (line < config_.lines) {
+        if (line % LINES_PER_FUNCTION == 0 && function < functions) {
+            if (function > 0) {
+                out << "    ret\n";
+            }
+            out << prefix << "f" << function++ << ":\n";
+        }
+        if (labelAt[line]) {
+            out << prefix << "l" << label++ << ":\n";
+        }
+
+        int32_t roll = pick(total);
+        std::string text;
+        if ((roll -= config_.mixAlu) < 0) {
+            text = aluLine();
+        }
+        else if ((roll -= config_.mixMem) < 0) {
+            text = memLine(object);
+        }
+        else if ((roll -= config_.mixBranch) < 0 && labels > 0) {
+            out << "    cmp " << reg() << ", " << pick(100) << "\n";
+            line++;
+            if (line < config_.lines && labelAt[line]) {
+                out << prefix << "l" << label++ << ":\n";
+            }
+            text = std::string(jumps[pick(7)]) + " " + prefix + "l" + std::to_string(pick(labels));
+        }
+        else if ((roll -= config_.mixCall) < 0) {
+            text = "call o" + std::to_string(pick(config_.objects)) + "_f" + std::to_string(pick(functions));
+        }
+        else {
+            text = config_.mixVector > 0 ? vectorLine(object) : aluLine();
+        }
+        out << "    " << text << comment() << "\n";
+        line++;
+    }
+
+    // Functions the line budget did not reach still have to exist for callers
+    while (function < functions) {
+        out << "    ret\n" << prefix << "f" << function++ << ":\n";
+    }
+    out << "    ret\n";
+    return out.str();
+}
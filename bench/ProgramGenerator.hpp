@@ -0,0 +1,52 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdint>
+
+struct GeneratorConfig {
+    int32_t lines = 10000;          // code lines per object file
+    int32_t objects = 1;
+    int32_t dataWords = 1024;       // per object file
+    double labelDensity = 0.05;     // chance that a code line gets a label
+    double commentDensity = 0.1;    // chance that a line ends in a comment
+    int32_t bits = 32;
+    uint32_t seed = 1;
+
+    // Relative weights of the instruction mix
+    int32_t mixAlu = 50;
+    int32_t mixMem = 25;
+    int32_t mixBranch = 15;
+    int32_t mixCall = 5;
+    int32_t mixVector = 5;
+};
+
+// Produces SLAM sources that assemble and link, for measuring the toolchain
+// at sizes real programs reach. Object 0 defines main. Branches stay inside
+// their object, calls may cross into any other. The programs are not meant
+// to be run.
+class ProgramGenerator {
+public:
+    ProgramGenerator(const GeneratorConfig& config);
+
+    // Same config and object index always give the same text
+    std::string generate(int32_t object);
+
+    // Parses "alu=50,mem=25,branch=15,call=5,vector=5", missing keys keep their weight
+    static void parseMix(const std::string& mix, GeneratorConfig& config);
+
+private:
+    int32_t functionCount() const;
+    int32_t pick(int32_t count);
+    bool chance(double p);
+    std::string reg();
+    std::string aluLine();
+    std::string memLine(int32_t object);
+    std::string vectorLine(int32_t object);
+
+    GeneratorConfig config_;
+    std::mt19937 rng_;
+};
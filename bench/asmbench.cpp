@@ -0,0 +1,268 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+// Assembler throughput benchmark. Build it as its own executable from this
+// file, ProgramGenerator.cpp, BenchStats.cpp and every .cpp in the root except
+// slam.cpp.
+//
+//   asmbench [--lines N] [--objects N] [--data WORDS] [--labels FRACTION]
+//            [--comments FRACTION] [--mix alu=50,mem=25,branch=15,call=5,vector=5]
+//            [--bits 32|64] [--seed N] [--samples N] [--jobs N] [-O] [--dir DIR] [--emit] [--csv FILE]
+//
+// Generates a synthetic program (see ProgramGenerator), writes it to DIR and
+// times each toolchain phase over all object files: mapping the sources,
+// lexing alone, parsing (which lexes again), compiling, writing the objects
+// and linking. Reports time, lines/s and source bytes/s per phase with a 95%
+// confidence interval, and how much each phase raised the process peak
+// resident memory in the first pass. --emit only writes the sources. --jobs
+// above 1 parses each source in parallel chunks (see Parser).
+
+#include "../Lexer.hpp"
+#include "../Parser.hpp"
+#include "../Compiler.hpp"
+#include "../Linker.hpp"
+#include "../ObjectFile.hpp"
+#include "../SourceFile.hpp"
+#include "../ThreadPool.hpp"
+#include "ProgramGenerator.hpp"
+#include "BenchStats.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+struct Options {
+    GeneratorConfig gen;
+    std::string dir;
+    std::string csvPath;
+    int32_t samples = 5;
+    int32_t jobs = 1;
+    bool optimize = false;
+    bool emitOnly = false;
+};
+
+enum Phase { MAP, LEX, PARSE, COMPILE, WRITE, LINK, PHASE_COUNT };
+const char* const phaseNames[PHASE_COUNT] = { "map", "lex", "parse", "compile", "write", "link" };
+
+uint64_t peakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return pmc.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+size_t lexOnly(std::string_view source) {
+    size_t tokens = 0;
+    Lexer lexer(source);
+    do {
+        while (!lexer.ended()) {
+            tokens++;
+            lexer.nextToken();
+        }
+    } while (lexer.nextLine());
+    return tokens;
+}
+
+class PhaseTimer {
+public:
+    void start() { start_ = std::chrono::steady_clock::now(); }
+    void stop(double& total) {
+        total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Adds how far the phase just finished raised the process peak
+void notePeak(uint64_t* peaks, Phase phase, uint64_t& lastPeak) {
+    if (!peaks) return;
+    uint64_t now = peakResidentBytes();
+    peaks[phase] += now - lastPeak;
+    lastPeak = now;
+}
+
+// One pass over every phase, adding milliseconds per phase to ms. peaks, when
+// non-null, gets the growth of peak memory per phase.
+void runOnce(const Options& opt, const std::vector<std::string>& sources, ThreadPool& pool, double* ms, uint64_t* peaks) {
+    PhaseTimer timer;
+    std::vector<ObjectFile> objects;
+    uint64_t lastPeak = peakResidentBytes();
+
+    for (const std::string& path : sources) {
+        timer.start();
+        SourceFile source(path);
+        timer.stop(ms[MAP]);
+        notePeak(peaks, MAP, lastPeak);
+
+        timer.start();
+        lexOnly(source.text());
+        timer.stop(ms[LEX]);
+        notePeak(peaks, LEX, lastPeak);
+
+        timer.start();
+        Parser parser(source.text(), pool);
+        timer.stop(ms[PARSE]);
+        notePeak(peaks, PARSE, lastPeak);
+
+        timer.start();
+        Compiler compiler(parser.getInstructions(), parser.getDataSegment(), parser.getDataLabels(),
+            parser.getDataRelocs(), parser.getLabels(), false, opt.optimize, parser.getBits());
+        objects.push_back(compiler.compile());
+        timer.stop(ms[COMPILE]);
+        notePeak(peaks, COMPILE, lastPeak);
+
+        timer.start();
+        WriteObjectFile(objects.back(), path.substr(0, path.size() - 4) + ".obj");
+        timer.stop(ms[WRITE]);
+        notePeak(peaks, WRITE, lastPeak);
+    }
+
+    timer.start();
+    Linker linker;
+    for (const ObjectFile& obj : objects) {
+        linker.addObjectFile(obj);
+    }
+    linker.link();
+    timer.stop(ms[LINK]);
+    notePeak(peaks, LINK, lastPeak);
+}
+
+Options parseOptions(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::runtime_error(arg + " expects a value");
+            return argv[++i];
+        };
+        if (arg == "--lines") opt.gen.lines = std::stoi(value());
+        else if (arg == "--objects") opt.gen.objects = std::stoi(value());
+        else if (arg == "--data") opt.gen.dataWords = std::stoi(value());
+        else if (arg == "--labels") opt.gen.labelDensity = std::stod(value());
+        else if (arg == "--comments") opt.gen.commentDensity = std::stod(value());
+        else if (arg == "--mix") ProgramGenerator::parseMix(value(), opt.gen);
+        else if (arg == "--bits") opt.gen.bits = std::stoi(value());
+        else if (arg == "--seed") opt.gen.seed = static_cast<uint32_t>(std::stoul(value()));
+        else if (arg == "--samples") opt.samples = std::max(2, std::stoi(value()));
+        else if (arg == "--jobs") opt.jobs = std::stoi(value());
+        else if (arg == "--dir") opt.dir = value();
+        else if (arg == "--csv") opt.csvPath = value();
+        else if (arg == "-O") opt.optimize = true;
+        else if (arg == "--emit") opt.emitOnly = true;
+        else throw std::runtime_error("Unknown option: " + arg);
+    }
+    if (opt.gen.bits != 32 && opt.gen.bits != 64) {
+        throw std::runtime_error("--bits expects 32 or 64");
+    }
+    if (opt.dir.empty()) {
+        opt.dir = (std::filesystem::temp_directory_path() / "slam_asmbench").string();
+    }
+    return opt;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        Options opt = parseOptions(argc, argv);
+        std::filesystem::create_directories(opt.dir);
+
+        ProgramGenerator generator(opt.gen);
+        std::vector<std::string> sources;
+        uint64_t totalLines = 0;
+        uint64_t totalBytes = 0;
+        for (int32_t i = 0; i < opt.gen.objects; i++) {
+            std::string text = generator.generate(i);
+            std::string path = (std::filesystem::path(opt.dir) / ("gen" + std::to_string(i) + ".asm")).string();
+            std::ofstream(path, std::ios::binary) << text;
+            sources.push_back(path);
+            totalBytes += text.size();
+            for (char c : text) {
+                if (c == '\n') totalLines++;
+            }
+        }
+
+        std::cout << "Generated " << opt.gen.objects << " object(s), " << totalLines << " lines, "
+            << totalBytes << " bytes in " << opt.dir << "\n";
+        if (opt.emitOnly) {
+            return 0;
+        }
+
+        // First pass warms the file cache and records peak memory per phase
+        double warm[PHASE_COUNT] = {};
+        uint64_t peaks[PHASE_COUNT] = {};
+        ThreadPool pool(opt.jobs);
+        runOnce(opt, sources, pool, warm, peaks);
+
+        std::vector<double> samples[PHASE_COUNT];
+        for (int32_t s = 0; s < opt.samples; s++) {
+            double ms[PHASE_COUNT] = {};
+            runOnce(opt, sources, pool, ms, nullptr);
+            for (int32_t p = 0; p < PHASE_COUNT; p++) {
+                samples[p].push_back(ms[p]);
+            }
+        }
+
+        std::ofstream csv;
+        if (!opt.csvPath.empty()) {
+            csv.open(opt.csvPath);
+            if (!csv) {
+                throw std::runtime_error("Failed to open " + opt.csvPath);
+            }
+            csv << "phase,mean_ms,ci95_low_ms,ci95_high_ms,lines_per_s,bytes_per_s,peak_growth_bytes,samples\n";
+        }
+
+        std::cout << std::left << std::setw(10) << "phase" << std::right << std::setw(12) << "ms"
+            << std::setw(11) << "95% CI" << std::setw(14) << "Klines/s" << std::setw(12) << "MB/s"
+            << std::setw(14) << "peak +MB" << "\n";
+        std::cout << std::fixed;
+        for (int32_t p = 0; p < PHASE_COUNT; p++) {
+            SampleStats st = sampleStats(samples[p]);
+            double seconds = st.mean / 1000.0;
+            double linesPerSec = seconds > 0 ? totalLines / seconds : 0.0;
+            double bytesPerSec = seconds > 0 ? totalBytes / seconds : 0.0;
+
+            std::cout << std::left << std::setw(10) << phaseNames[p] << std::right << std::setprecision(2)
+                << std::setw(12) << st.mean << " +/- " << std::setw(6) << (st.ciHigh - st.mean)
+                << std::setw(14) << linesPerSec / 1e3 << std::setw(12) << bytesPerSec / 1e6
+                << std::setw(14) << peaks[p] / 1e6 << "\n";
+
+            if (csv) {
+                csv << phaseNames[p] << "," << st.mean << "," << st.ciLow << "," << st.ciHigh << ","
+                    << linesPerSec << "," << bytesPerSec << "," << peaks[p] << "," << st.samples << "\n";
+            }
+        }
+        std::cout << std::defaultfloat << "Peak resident memory: " << peakResidentBytes() / 1e6 << " MB\n";
+    }
+    catch (const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,585 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+// VM benchmark suite. Build it as its own executable from this file, BenchStats.cpp
+// and every .cpp in the root except slam.cpp, and run it from the repository root.
+//
+//   bench [--suite opcodes|programs|synthetic|all] [--filter TEXT] [--bits 32|64]
+//         [--samples N] [--programs DIR] [--csv FILE] [--compare FILE] [--threshold PCT]
+//
+// opcodes    ns per dispatch of every opcode in each operand-kind combination
+// programs   end-to-end runs of every *.asm in DIR (default x64/Release)
+// synthetic  parametrised loops: ALU body length, memory sweep size, call
+//            depth and the counted-loop fast path
+//
+// Every result is the mean over --samples timed samples with a 95% confidence
+// interval. --csv writes the results, --compare reads an earlier --csv file
+// and marks each case whose interval no longer overlaps the stored one; the
+// exit code is 1 when such a case got slower by more than --threshold percent.
+
+#include "../Parser.hpp"
+#include "../Compiler.hpp"
+#include "../Linker.hpp"
+#include "../VM.hpp"
+#include "BenchStats.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <stdexcept>
+
+namespace {
+
+struct Options {
+    std::string suite = "all";
+    std::string filter;
+    std::string programsDir = "x64/Release";
+    std::string csvPath;
+    std::string comparePath;
+    int32_t bits = 32;
+    int32_t samples = 10;
+    double threshold = 5.0;
+};
+
+struct Result {
+    std::string suite;
+    std::string name;
+    uint64_t dispatches = 0;  // instructions retired per measured run
+    double mean = 0;          // ns per dispatch
+    double median = 0;
+    double stddev = 0;
+    double ciLow = 0;
+    double ciHigh = 0;
+    int32_t samples = 0;
+};
+
+// A linked image and the VM width it needs
+struct Program {
+    std::vector<uint8_t> image;
+    int32_t bits = 32;
+};
+
+ObjectFile assemble(const std::vector<std::string>& source, bool optimize) {
+    std::vector<std::string> lines;
+    for (std::string line : source) {
+        size_t commentPos = line.find(';');
+        if (commentPos != std::string::npos) {
+            line = line.substr(0, commentPos);
+        }
+        lines.push_back(line);
+    }
+
+    Parser parser(lines);
+    Compiler compiler(parser.getInstructions(), parser.getDataSegment(), parser.getDataLabels(),
+        parser.getDataRelocs(), parser.getLabels(), false, optimize, parser.getBits());
+    return compiler.compile();
+}
+
+Program build(const std::vector<std::string>& source, bool optimize = false) {
+    Linker linker;
+    linker.addObjectFile(assemble(source, optimize));
+    Program p;
+    p.image = linker.link();
+    p.bits = linker.getBits();
+    return p;
+}
+
+std::vector<std::string> splitLines(const std::string& text) {
+    std::vector<std::string> lines;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// Runs the image once on the VM matching its width, returns elapsed ns and
+// sets retired to the instruction count. VM setup is not timed.
+template<typename VMType>
+double timeRunOn(const Program& p, uint64_t& retired) {
+    VMType vm(p.image);
+    auto start = std::chrono::steady_clock::now();
+    vm.run();
+    auto end = std::chrono::steady_clock::now();
+    retired = vm.counters().snapshot().instructionsRetired();
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+double timeRun(const Program& p, uint64_t& retired) {
+    return p.bits == 64 ? timeRunOn<VM64>(p, retired) : timeRunOn<VM>(p, retired);
+}
+
+// Enough back-to-back runs for a sample of roughly 2ms, so short programs
+// are not lost in timer resolution
+int32_t repetitionsFor(const Program& p) {
+    uint64_t retired = 0;
+    timeRun(p, retired);
+    double once = std::max(timeRun(p, retired), 1.0);
+    return static_cast<int32_t>(std::clamp(2e6 / once, 1.0, 100000.0));
+}
+
+Result summarise(const std::string& suite, const std::string& name, const std::vector<double>& values, uint64_t dispatches) {
+    SampleStats s = sampleStats(values);
+    Result r;
+    r.suite = suite;
+    r.name = name;
+    r.dispatches = dispatches;
+    r.mean = s.mean;
+    r.median = s.median;
+    r.stddev = s.stddev;
+    r.ciLow = s.ciLow;
+    r.ciHigh = s.ciHigh;
+    r.samples = s.samples;
+    return r;
+}
+
+void printResult(const Result& r) {
+    std::cout << std::left << std::setw(10) << r.suite << std::setw(44) << r.name << std::right
+        << std::fixed << std::setprecision(2)
+        << std::setw(10) << r.mean << " +/- " << std::setw(6) << (r.ciHigh - r.mean)
+        << std::setw(10) << r.median << std::setw(12) << r.dispatches << "\n"
+        << std::defaultfloat;
+}
+
+bool selected(const Options& opt, const std::string& suite, const std::string& name) {
+    if (opt.suite != "all" && opt.suite != suite) return false;
+    return opt.filter.empty() || (suite + "/" + name).find(opt.filter) != std::string::npos;
+}
+
+// ---------------------------------------------------------------------------
+// Opcode matrix
+//
+// Each case is a loop running OPCODE_COPIES copies of one instruction (or a
+// balanced pair such as PUSH/POP) OPCODE_ROUNDS times. The same loop with an
+// empty body is run alongside, and the difference in time divided by the
+// difference in retired instructions is the cost of one dispatch.
+
+constexpr int32_t OPCODE_COPIES = 32;
+constexpr int32_t OPCODE_ROUNDS = 2000;
+
+struct Kind {
+    const char* name;
+    const char* text;
+};
+
+// Destinations write "dst" so sources keep reading the nonzero "slot"
+const Kind destKinds[] = {
+    { "reg", "r1" }, { "mem", "[dst]" }, { "memreg", "[r9]" }, { "indexed", "[r9 + r11*4]" }
+};
+const Kind srcKinds[] = {
+    { "reg", "r2" }, { "imm", "3" }, { "mem", "[slot]" }, { "memreg", "[r10]" }, { "indexed", "[r10 + r11*4]" }
+};
+const Kind imm64Kind = { "imm64", "5000000003" };
+
+struct OpcodeCase {
+    std::string name;
+    std::string body;   // one copy, "#" is replaced by the copy number for unique labels
+};
+
+std::string replaceAll(std::string s, const std::string& from, const std::string& to) {
+    for (size_t pos = s.find(from); pos != std::string::npos; pos = s.find(from, pos + to.size())) {
+        s.replace(pos, from.size(), to);
+    }
+    return s;
+}
+
+std::vector<OpcodeCase> opcodeCases(int32_t bits) {
+    std::vector<OpcodeCase> cases;
+    std::vector<Kind> sources(std::begin(srcKinds), std::end(srcKinds));
+    if (bits == 64) {
+        sources.push_back(imm64Kind);
+    }
+
+    auto add = [&](const std::string& name, const std::string& body) { cases.push_back({ name, body }); };
+
+    for (const char* op : { "MOV", "AND", "OR", "XOR", "SHL", "SHR", "CMP" }) {
+        for (const Kind& d : destKinds) {
+            for (const Kind& s : sources) {
+                add(std::string(op) + " " + d.name + ", " + s.name, std::string(op) + " " + d.text + ", " + s.text);
+            }
+        }
+    }
+    for (const char* op : { "ADD", "SUB", "MUL", "DIV" }) {
+        for (const Kind& d : destKinds) {
+            for (const Kind& s : sources) {
+                add(std::string(op) + " " + d.name + ", " + s.name + ", reg",
+                    std::string(op) + " " + d.text + ", " + s.text + ", r3");
+            }
+        }
+        for (const Kind& s : sources) {
+            if (std::string(s.name) == "reg") continue;
+            add(std::string(op) + " reg, reg, " + s.name, std::string(op) + " r1, r2, " + s.text);
+        }
+    }
+    for (const char* op : { "CMOVE", "CMOVNE", "CMOVG", "CMOVL", "CMOVLE", "CMOVGE" }) {
+        for (const Kind& d : destKinds) {
+            for (const Kind& s : sources) {
+                add(std::string(op) + " " + d.name + ", " + s.name, std::string(op) + " " + d.text + ", " + s.text);
+            }
+        }
+    }
+    for (const char* op : { "SETE", "SETNE", "SETG", "SETL", "SETLE", "SETGE" }) {
+        for (const Kind& d : destKinds) {
+            add(std::string(op) + " " + d.name, std::string(op) + " " + d.text);
+        }
+    }
+    for (const Kind& s : { srcKinds[2], srcKinds[3], srcKinds[4] }) {
+        add(std::string("LOAD reg, ") + s.name, std::string("LOAD r1, ") + s.text);
+    }
+    for (const Kind& d : { destKinds[1], destKinds[2], destKinds[3] }) {
+        add(std::string("STORE ") + d.name + ", reg", std::string("STORE ") + d.text + ", r2");
+    }
+
+    // The loop condition leaves GF set for the whole body
+    for (const char* op : { "JMP", "JNE", "JG", "JGE" }) {
+        add(std::string(op) + " label (taken)", std::string(op) + " L#\nL#:");
+    }
+    for (const char* op : { "JE", "JL", "JLE" }) {
+        add(std::string(op) + " label (not taken)", std::string(op) + " L#\nL#:");
+    }
+    add("JMP reg", "mov r8, L#\njmp r8\nL#:");
+    add("LOOP reg, label", "loop r12, L#\nL#:");
+
+    // Balanced pairs, the result is the mean of the two dispatches
+    for (const Kind& s : sources) {
+        add(std::string("PUSH ") + s.name + " + POP reg", std::string("push ") + s.text + "\npop r1");
+    }
+    add("PUSH reg + POP mem", "push r2\npop [dst]");
+    add("PUSHM 4 + POPM 4", "pushm r1, r2, r3, r4\npopm r1, r2, r3, r4");
+    add("CALL label + RET", "call leaf");
+    add("CALL reg + RET", "call r7");
+    add("ENTER + LEAVE", "enter 16\nleave");
+    add("ALLOC 32 + FREE", "alloc r1, 32\nfree r1");
+    add("ALLOC 8K + FREE", "alloc r1, 8192\nfree r1");
+    add("CALL + NATIVE __memcpy 3", "call __memcpy");
+
+    add("VLOAD vec, mem", "vload v1, [vec]");
+    add("VLOAD vec, indexed", "vload v1, [r10 + r11*4]");
+    add("VSTORE mem, vec", "vstore [vdst], v1");
+    for (const char* op : { "VADD", "VSUB", "VMUL", "VAND", "VXOR", "VCMPEQ", "VCMPGT" }) {
+        add(std::string(op) + " vec, vec, vec", std::string(op) + " v1, v2, v3");
+    }
+    add("VSPLAT vec, reg", "vsplat v1, r2");
+    add("VSPLAT vec, imm", "vsplat v1, 3");
+    add("VEXTRACT reg, vec, imm", "vextract r1, v2, 1");
+    return cases;
+}
+
+std::string opcodeProgram(int32_t bits, const std::string& body, int32_t copies) {
+    std::ostringstream s;
+    const char* word = bits == 64 ? ".dword" : ".word";
+    if (bits == 64) s << ".bits 64\n";
+    s << ".data\n"
+        << "slot: " << word << " 3\n"
+        << "dst: " << word << " 0\n"
+        << "vec: .word 1, 2, 3, 4\n"
+        << "vdst: .word 0, 0, 0, 0\n"
+        << ".code\n"
+        << "leaf:\n"
+        << "    ret\n"
+        << "main:\n"
+        << "    mov r13, " << OPCODE_ROUNDS << "\n"
+        << "    mov r0, dst\n"       // __memcpy(dst, slot, 3)
+        << "    mov r1, slot\n"
+        << "    mov r2, 3\n"
+        << "    mov r3, 5\n"
+        << "    mov r7, leaf\n"
+        << "    mov r9, dst\n"
+        << "    mov r10, slot\n"
+        << "    mov r11, 0\n"
+        << "    mov r12, 1000000000\n"
+        << "    vload v2, [vec]\n"
+        << "    vload v3, [vec]\n"
+        << "top:\n";
+    for (int32_t i = 0; i < copies; i++) {
+        s << replaceAll(body, "#", std::to_string(i)) << "\n";
+    }
+    s << "    sub r13, r13, 1\n"
+        << "    cmp r13, 0\n"
+        << "    jg top\n"
+        << "    ret\n";
+    return s.str();
+}
+
+void runOpcodes(const Options& opt, std::vector<Result>& results) {
+    Program empty = build(splitLines(opcodeProgram(opt.bits, "", 0)));
+
+    for (const OpcodeCase& c : opcodeCases(opt.bits)) {
+        std::string name = c.name + (opt.bits == 64 ? " [64]" : "");
+        if (!selected(opt, "opcodes", name)) continue;
+
+        Program p;
+        try {
+            p = build(splitLines(opcodeProgram(opt.bits, c.body, OPCODE_COPIES)));
+        }
+        catch (const std::exception& ex) {
+            std::cerr << "opcodes/" << name << ": skipped, " << ex.what() << "\n";
+            continue;
+        }
+
+        // Interleaved so drift in clock speed hits both sides of the difference
+        std::vector<double> values;
+        uint64_t dispatches = 0;
+        for (int32_t i = 0; i < opt.samples + 1; i++) {
+            uint64_t retiredCase = 0, retiredBase = 0;
+            double tCase = timeRun(p, retiredCase);
+            double tBase = timeRun(empty, retiredBase);
+            dispatches = retiredCase - retiredBase;
+            if (i == 0) continue;   // warm-up
+            values.push_back((tCase - tBase) / static_cast<double>(dispatches));
+        }
+
+        results.push_back(summarise("opcodes", name, values, dispatches));
+        printResult(results.back());
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Whole programs
+
+void measureProgram(const Options& opt, const std::string& suite, const std::string& name, const Program& p,
+    std::vector<Result>& results) {
+    int32_t reps = repetitionsFor(p);
+    std::vector<double> values;
+    uint64_t dispatches = 0;
+    for (int32_t i = 0; i < opt.samples; i++) {
+        double total = 0;
+        uint64_t retired = 0;
+        for (int32_t r = 0; r < reps; r++) {
+            total += timeRun(p, retired);
+        }
+        dispatches = retired;
+        values.push_back(total / reps / static_cast<double>(std::max<uint64_t>(retired, 1)));
+    }
+    results.push_back(summarise(suite, name, values, dispatches));
+    printResult(results.back());
+}
+
+void runPrograms(const Options& opt, std::vector<Result>& results) {
+    std::vector<std::filesystem::path> files;
+    if (std::filesystem::is_directory(opt.programsDir)) {
+        for (const auto& entry : std::filesystem::directory_iterator(opt.programsDir)) {
+            if (entry.path().extension() == ".asm") files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    for (const auto& path : files) {
+        std::string name = path.filename().string();
+        if (!selected(opt, "programs", name)) continue;
+
+        std::ifstream in(path);
+        std::vector<std::string> source;
+        std::string line;
+        bool hasMain = false;
+        while (std::getline(in, line)) {
+            std::string upper = line;
+            std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+            if (upper.find("MAIN:") != std::string::npos) hasMain = true;
+            source.push_back(line);
+        }
+        // Snippets without an entry point run from their first instruction
+        if (!hasMain) {
+            source.insert(source.begin(), "main:");
+        }
+
+        try {
+            measureProgram(opt, "programs", name, build(source), results);
+        }
+        catch (const std::exception& ex) {
+            std::cerr << "programs/" << name << ": skipped, " << ex.what() << "\n";
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Synthetic loops
+
+std::string aluLoop(int32_t iterations, int32_t bodyLength) {
+    std::ostringstream s;
+    s << "main:\n    mov r0, " << iterations << "\n    mov r2, 7\ntop:\n    cmp r0, 0\n    jle exit\n";
+    const char* ops[] = { "add r1, r1, r2", "xor r3, r1", "sub r4, r3, r1", "and r5, 255" };
+    for (int32_t i = 0; i < bodyLength; i++) {
+        s << "    " << ops[i % 4] << "\n";
+    }
+    s << "    sub r0, r0, 1\n    jmp top\nexit:\n    ret\n";
+    return s.str();
+}
+
+// Loads one word per 64-byte line across a buffer, bytes must be a multiple of 64
+std::string memorySweep(int32_t passes, int32_t bytes) {
+    std::ostringstream s;
+    s << "main:\n    mov r0, " << passes << "\n    mov r9, 4096\n"
+        << "pass:\n    cmp r0, 0\n    jle exit\n    mov r1, " << bytes / 64 << "\n    mov r2, 0\n"
+        << "line:\n    cmp r1, 0\n    jle next\n    load r3, [r9 + r2*1]\n    add r2, r2, 64\n"
+        << "    sub r1, r1, 1\n    jmp line\n"
+        << "next:\n    sub r0, r0, 1\n    jmp pass\nexit:\n    ret\n";
+    return s.str();
+}
+
+std::string callChain(int32_t iterations, int32_t depth) {
+    std::ostringstream s;
+    for (int32_t d = 0; d < depth; d++) {
+        s << "f" << d << ":\n";
+        if (d + 1 < depth) s << "    call f" << d + 1 << "\n";
+        s << "    ret\n";
+    }
+    s << "main:\n    mov r0, " << iterations << "\ntop:\n    cmp r0, 0\n    jle exit\n"
+        << "    call f0\n    sub r0, r0, 1\n    jmp top\nexit:\n    ret\n";
+    return s.str();
+}
+
+void runSynthetic(const Options& opt, std::vector<Result>& results) {
+    struct Case {
+        std::string name;
+        std::string source;
+        bool optimize;
+    };
+    std::vector<Case> cases;
+    for (int32_t body : { 1, 8, 64 }) {
+        cases.push_back({ "alu body=" + std::to_string(body), aluLoop(200000 / body, body), false });
+        cases.push_back({ "alu body=" + std::to_string(body) + " -O", aluLoop(200000 / body, body), true });
+    }
+    for (int32_t kb : { 4, 64, 256 }) {
+        cases.push_back({ "sweep " + std::to_string(kb) + "KB", memorySweep(std::max(1, 1024 / kb), kb * 1024), false });
+    }
+    for (int32_t depth : { 1, 16, 256 }) {
+        cases.push_back({ "calls depth=" + std::to_string(depth), callChain(std::max(1, 20000 / depth), depth), false });
+    }
+
+    for (const Case& c : cases) {
+        std::string name = c.name + (opt.bits == 64 ? " [64]" : "");
+        if (!selected(opt, "synthetic", name)) continue;
+        std::string source = (opt.bits == 64 ? ".bits 64\n" : "") + c.source;
+        measureProgram(opt, "synthetic", name, build(splitLines(source), c.optimize), results);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// CSV and baseline comparison
+
+void writeCsv(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    out << "suite,name,dispatches,mean_ns,median_ns,stddev_ns,ci95_low_ns,ci95_high_ns,samples\n";
+    out << std::setprecision(6);
+    for (const Result& r : results) {
+        out << r.suite << ",\"" << r.name << "\"," << r.dispatches << "," << r.mean << "," << r.median << ","
+            << r.stddev << "," << r.ciLow << "," << r.ciHigh << "," << r.samples << "\n";
+    }
+}
+
+std::map<std::string, Result> readCsv(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    std::map<std::string, Result> rows;
+    std::string line;
+    std::getline(in, line); // header
+    while (std::getline(in, line)) {
+        // Names are quoted since they contain commas
+        size_t q1 = line.find('"');
+        size_t q2 = line.find('"', q1 + 1);
+        if (q1 == std::string::npos || q2 == std::string::npos) continue;
+
+        Result r;
+        r.suite = line.substr(0, q1 - 1);
+        r.name = line.substr(q1 + 1, q2 - q1 - 1);
+        std::istringstream rest(line.substr(q2 + 2));
+        char comma;
+        rest >> r.dispatches >> comma >> r.mean >> comma >> r.median >> comma >> r.stddev >> comma
+            >> r.ciLow >> comma >> r.ciHigh >> comma >> r.samples;
+        rows[r.suite + "/" + r.name] = r;
+    }
+    return rows;
+}
+
+// Returns the number of significant regressions beyond the threshold
+int32_t compare(const std::string& path, const std::vector<Result>& results, double threshold) {
+    std::map<std::string, Result> baseline = readCsv(path);
+    int32_t regressions = 0;
+
+    std::cout << "\n--- Compared with " << path << " ---\n";
+    for (const Result& r : results) {
+        auto it = baseline.find(r.suite + "/" + r.name);
+        if (it == baseline.end()) continue;
+
+        const Result& b = it->second;
+        double delta = b.mean != 0 ? 100.0 * (r.mean - b.mean) / b.mean : 0.0;
+        bool separate = r.ciLow > b.ciHigh || r.ciHigh < b.ciLow;
+        const char* verdict = !separate ? "~" : (delta > 0 ? "slower" : "faster");
+        if (separate && delta > threshold) regressions++;
+
+        std::cout << std::left << std::setw(10) << r.suite << std::setw(44) << r.name << std::right
+            << std::fixed << std::setprecision(2) << std::setw(10) << b.mean << std::setw(10) << r.mean
+            << std::showpos << std::setw(9) << delta << "%" << std::noshowpos << "  " << verdict << "\n"
+            << std::defaultfloat;
+    }
+    std::cout << "--- " << regressions << " regression(s) above " << threshold << "% ---\n";
+    return regressions;
+}
+
+Options parseOptions(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::runtime_error(arg + " expects a value");
+            return argv[++i];
+        };
+        if (arg == "--suite") opt.suite = value();
+        else if (arg == "--filter") opt.filter = value();
+        else if (arg == "--programs") opt.programsDir = value();
+        else if (arg == "--csv") opt.csvPath = value();
+        else if (arg == "--compare") opt.comparePath = value();
+        else if (arg == "--bits") opt.bits = std::stoi(value());
+        else if (arg == "--samples") opt.samples = std::max(2, std::stoi(value()));
+        else if (arg == "--threshold") opt.threshold = std::stod(value());
+        else throw std::runtime_error("Unknown option: " + arg);
+    }
+    if (opt.bits != 32 && opt.bits != 64) {
+        throw std::runtime_error("--bits expects 32 or 64");
+    }
+    return opt;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        Options opt = parseOptions(argc, argv);
+        std::vector<Result> results;
+
+        std::cout << std::left << std::setw(10) << "suite" << std::setw(44) << "case" << std::right
+            << std::setw(10) << "ns/disp" << std::setw(11) << "95% CI" << std::setw(10) << "median"
+            << std::setw(12) << "dispatches" << "\n";
+
+        runOpcodes(opt, results);
+        runPrograms(opt, results);
+        runSynthetic(opt, results);
+
+        if (!opt.csvPath.empty()) {
+            writeCsv(opt.csvPath, results);
+        }
+        if (!opt.comparePath.empty() && compare(opt.comparePath, results, opt.threshold) > 0) {
+            return 1;
+        }
+    }
+    catch (const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+        return 2;
+    }
+    return 0;
+}
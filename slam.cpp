@@ -8,12 +8,21 @@
 #include <cctype>
 #include <stdexcept>
 #include <cstring>
+#include <sstream>
+#include <memory>
 
 #include "Lexer.hpp"
 #include "Parser.hpp"
 #include "Compiler.hpp"
 #include "Linker.hpp"
 #include "VM.hpp"
+#include "Profiler.hpp"
+#include "CacheSim.hpp"
+#include "SourceFile.hpp"
+#include "ThreadPool.hpp"
+#include "ObjectCache.hpp"
+#include "ModuleCache.hpp"
+#include <filesystem>
 
 std::string stripExtension(const std::string& path) {
     size_t last_slash = path.find_last_of("/\\");
@@ -28,30 +37,64 @@ std::string stripExtension(const std::string& path) {
     return path.substr(0, last_dot);
 }
 
-ObjectFile compileFile(const std::string& str, bool debug = false)
+bool hasOption(int32_t argc, int8_t* argv[], const std::string& option)
 {
-    std::ifstream file(str);
-    if (!file) {
-        std::string err = "Failed to open " + str;
-        throw std::exception(err.c_str());
-    }
-
-    std::vector<std::string> lines;
-    std::string line;
-    while (std::getline(file, line)) {
-        // Strip comments starting with ';'
-        size_t commentPos = line.find(';');
-        if (commentPos != std::string::npos) {
-            line = line.substr(0, commentPos);
+    for (int32_t i = 1; i < argc; i++) {
+        if (option == reinterpret_cast<const char*>(argv[i])) {
+            return true;
         }
-        // Trim trailing spaces
-        while (!line.empty() && (line.back() == ' ' || line.back() == '\t'))
-            line.pop_back();
-        lines.push_back(line);
+    }
+    return false;
+}
+
+// Value following an option such as "-j 8", or fallback if the option is absent
+std::string optionValue(int32_t argc, int8_t* argv[], const std::string& option, const std::string& fallback)
+{
+    for (int32_t i = 1; i + 1 < argc; i++) {
+        if (option == reinterpret_cast<const char*>(argv[i])) {
+            return reinterpret_cast<const char*>(argv[i + 1]);
+        }
+    }
+    return fallback;
+}
+
+// Arguments that are neither options nor option values
+std::vector<std::string> sourceArguments(int32_t argc, int8_t* argv[])
+{
+    std::vector<std::string> sources;
+    for (int32_t i = 1; i < argc; i++) {
+        std::string arg = reinterpret_cast<const char*>(argv[i]);
+        if (arg == "-j" || arg == "--cache-dir") {
+            i++;
+        }
+        else if (arg.empty() || arg[0] != '-') {
+            sources.push_back(arg);
+        }
+    }
+    return sources;
+}
+
+// Optimizer statistics go to log, so parallel builds can print them in source order.
+// Large sources are parsed in chunks on pool, included files are parsed once per modules.
+ObjectFile compileFile(const std::string& str, bool debug, bool optimize, std::ostream& log, ThreadPool& pool,
+    ModuleCache& modules)
+{
+    // Mapped and lexed in place, comments are skipped by the lexer
+    SourceFile source(str);
+    std::string directory = std::filesystem::path(str).parent_path().string();
+
+    // Single pass: each instruction is encoded as soon as it is parsed and never
+    // stored. The optimizer needs the whole list, and a source big enough to be
+    // parsed in parallel chunks is faster that way.
+    if (!optimize && !Parser::parsesInChunks(source.text().size(), pool)) {
+        Compiler compiler(debug);
+        Parser parser(source.text(), [&](const Instruction& ins, int32_t bits) { compiler.emit(ins, bits); },
+            debug, &modules, directory);
+        return compiler.finish(parser);
     }
 
-    Parser parser(lines, debug);
-    auto instructions = parser.getInstructions();
+    Parser parser(source.text(), pool, debug, &modules, directory);
+    const auto& instructions = parser.getInstructions();
 
         /*
     for (auto& instr : instructions)
@@ -64,7 +107,7 @@ ObjectFile compileFile(const std::string& str, bool debug = false)
         {
             if (oper.isLabel)
             {
-                std::cout << oper.labelName;
+                std::cout << parser.getLabels().name(oper.labelId);
             }
             else if (oper.isMemory)
             {
@@ -92,39 +135,139 @@ ObjectFile compileFile(const std::string& str, bool debug = false)
 
     for (auto& lab : parser.getDataLabels())
     {
-        std::cout << lab.first << " " << lab.second << std::endl;
+        std::cout << parser.getLabels().name(lab.first) << " " << lab.second << std::endl;
     }
 
     std::cout << "\n";
     */
 
-    Compiler compiler(instructions, parser.getDataSegment(), parser.getDataLabels(), debug);
+    Compiler compiler(instructions, parser.getDataSegment(), parser.getDataLabels(), parser.getDataRelocs(),
+        parser.getLabels(), debug, optimize, parser.getBits());
+
+    ObjectFile obj = compiler.compile();
+    if (optimize) {
+        log << str << ": ";
+        compiler.getOptimizer().printStats(log);
+    }
+    return obj;
+}
+
+// Assembles every source and writes its .obj on the pool, one file per task.
+// Objects come back in source order however the tasks finish, so the link
+// is the same on every run; the first failing source in that order is reported.
+// With a cache, unchanged sources are read back instead of assembled.
+std::vector<ObjectFile> compileFiles(const std::vector<std::string>& sources, ThreadPool& pool,
+    ObjectCache* cache, bool debug, bool optimize)
+{
+    std::vector<ObjectFile> objects(sources.size());
+    std::vector<std::ostringstream> logs(sources.size());
+    ModuleCache modules;
+
+    pool.run(sources.size(), [&](size_t i) {
+        std::string key;
+        if (cache) {
+            key = ObjectCache::key(SourceFile(sources[i]).text(),
+                std::filesystem::path(sources[i]).parent_path().string(), optimize);
+        }
+        if (!key.empty() && cache->load(key, objects[i])) {
+            if (optimize) {
+                logs[i] << sources[i] << ": unchanged, reused cached object\n";
+            }
+        }
+        else {
+            objects[i] = compileFile(sources[i], debug, optimize, logs[i], pool, modules);
+            if (!key.empty()) {
+                cache->store(key, objects[i]);
+            }
+        }
+        WriteObjectFile(objects[i], stripExtension(sources[i]) + ".obj");
+        });
+
+    for (const auto& log : logs) {
+        std::cout << log.str();
+    }
+    if (optimize && modules.hits() + modules.misses() > 0) {
+        std::cout << "Included modules: " << modules.misses() << " parsed, " << modules.hits() << " reused\n";
+    }
+    return objects;
+}
+
+// Runs a linked image on the VM matching its register width (VM or VM64)
+template<typename VMType>
+void runImage(const std::vector<uint8_t>& bytecode, const Linker& linker, int32_t argc, int8_t* argv[])
+{
+    VMType vm(bytecode, 1048576, 65536, false);
+
+    // --profile counts instructions per call path, --profile-time samples wall time
+    bool profileTime = hasOption(argc, argv, "--profile-time");
+    bool profile = profileTime || hasOption(argc, argv, "--profile");
+    Profiler profiler(linker.getSymbols(), linker.getSymbolNames(), profileTime ? ProfileMode::WALL_TIME : ProfileMode::INSTRUCTIONS);
+    if (profile) {
+        vm.setProfiler(&profiler);
+    }
+
+    CacheSim cacheSim(CacheSim::defaultLevels(), linker.getSymbols(), linker.getSymbolNames(), bytecode.size());
+    bool simulateCache = hasOption(argc, argv, "--cachesim");
+    if (simulateCache) {
+        vm.setCacheSim(&cacheSim);
+    }
+
+    vm.run();
+    vm.printRegisters();
+
+    if (profile) {
+        profiler.printReport();
+        profiler.writeCollapsed("slam.folded");
+    }
+
+    if (simulateCache) {
+        cacheSim.printReport();
+    }
 
-    return compiler.compile();
+    if (hasOption(argc, argv, "--counters")) {
+        vm.printCounters();
+    }
+
+    if (hasOption(argc, argv, "--heapstats")) {
+        vm.heap().printStats();
+    }
 }
 
 int32_t main(int32_t argc, int8_t *argv[])
 {
     try {
-        auto obj = compileFile("memtest.asm");
-        auto obj2 = compileFile("fib.asm");
-        auto obj3 = compileFile("euclid.asm");
+        // -O runs the optimizer passes (e.g. counted loops to LOOP) before emission
+        bool optimize = hasOption(argc, argv, "-O");
 
-        WriteObjectFile(obj, stripExtension("memtest.asm") + ".obj");
-        WriteObjectFile(obj2, stripExtension("fib.asm") + ".obj");
-        WriteObjectFile(obj3, stripExtension("euclid.asm") + ".obj");
+        // Sources are assembled in parallel, -j sets the thread count (default: all hardware threads)
+        std::vector<std::string> sources = sourceArguments(argc, argv);
+        if (sources.empty()) {
+            sources = { "memtest.asm", "fib.asm", "euclid.asm" };
+        }
+        ThreadPool pool(std::stoi(optionValue(argc, argv, "-j", "0")));
+
+        // Assembled objects are cached by source content, --no-cache always assembles
+        std::unique_ptr<ObjectCache> cache;
+        if (!hasOption(argc, argv, "--no-cache")) {
+            cache = std::make_unique<ObjectCache>(optionValue(argc, argv, "--cache-dir", ".slamcache"));
+        }
+
+        std::vector<ObjectFile> objects = compileFiles(sources, pool, cache.get(), false, optimize);
 
         Linker linker(false);
 
-        linker.addObjectFile(obj);
-        linker.addObjectFile(obj2);
-        linker.addObjectFile(obj3);
+        for (const auto& obj : objects) {
+            linker.addObjectFile(obj);
+        }
 
         auto bytecode = linker.link();
 
-        VM vm(bytecode, 1048576, 65536, false);
-        vm.run();
-        vm.printRegisters();
+        if (linker.getBits() == 64) {
+            runImage<VM64>(bytecode, linker, argc, argv);
+        }
+        else {
+            runImage<VM>(bytecode, linker, argc, argv);
+        }
 
         std::cout << "Program finished successfully.\n";
     }
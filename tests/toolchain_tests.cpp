@@ -0,0 +1,254 @@
+// Slam Assembler (C) 2025 Lynton "Pionwave" Schneider
+
+// Toolchain regression tests. Build it as its own executable from this file
+// and every .cpp in the root except slam.cpp, and run it with no arguments.
+//
+// Each test writes its sources to a scratch directory, assembles them the way
+// slam does and checks the resulting objects or the registers after a run.
+// Prints one line per test and exits with 1 if any failed.
+
+#include "../Parser.hpp"
+#include "../Compiler.hpp"
+#include "../Linker.hpp"
+#include "../VM.hpp"
+#include "../ObjectFile.hpp"
+#include "../SourceFile.hpp"
+#include "../ThreadPool.hpp"
+#include "../ModuleCache.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <stdexcept>
+
+namespace {
+
+std::filesystem::path scratchDir() {
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "slam_tests";
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+
+std::string writeSource(const std::string& name, const std::string& text) {
+    std::string path = (scratchDir() / name).string();
+    std::ofstream(path, std::ios::binary) << text;
+    return path;
+}
+
+std::string directoryOf(const std::string& path) {
+    return std::filesystem::path(path).parent_path().string();
+}
+
+// As slam assembles a small source without -O: each instruction is encoded
+// as soon as it is parsed
+ObjectFile assembleStreamed(const std::string& path) {
+    SourceFile source(path);
+    ModuleCache modules;
+    Compiler compiler;
+    Parser parser(source.text(), [&](const Instruction& ins, int32_t bits) { compiler.emit(ins, bits); },
+        false, &modules, directoryOf(path));
+    return compiler.finish(parser);
+}
+
+// As slam assembles with -O or a large source: the whole list is parsed first
+ObjectFile assembleBuffered(const std::string& path, bool optimize) {
+    SourceFile source(path);
+    ModuleCache modules;
+    ThreadPool pool(1);
+    Parser parser(source.text(), pool, false, &modules, directoryOf(path));
+    Compiler compiler(parser.getInstructions(), parser.getDataSegment(), parser.getDataLabels(),
+        parser.getDataRelocs(), parser.getLabels(), false, optimize, parser.getBits());
+    return compiler.compile();
+}
+
+// The object as written to disk
+std::string objectBytes(const ObjectFile& obj) {
+    std::string path = (scratchDir() / "object.tmp").string();
+    WriteObjectFile(obj, path);
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream bytes;
+    bytes << in.rdbuf();
+    return bytes.str();
+}
+
+template<typename V>
+std::vector<int64_t> registersAfter(const std::vector<uint8_t>& image) {
+    V vm(image);
+    vm.run();
+    std::vector<int64_t> regs;
+    for (int32_t i = 0; i < 16; i++) {
+        regs.push_back(vm.getRegister(i));
+    }
+    return regs;
+}
+
+// R0-R14 after linking the objects and running from main. R15 is left out:
+// the optimizer moves code, and with it the address execution ends at.
+std::vector<int64_t> run(const std::vector<ObjectFile>& objects) {
+    Linker linker;
+    for (const ObjectFile& obj : objects) {
+        linker.addObjectFile(obj);
+    }
+    std::vector<uint8_t> image = linker.link();
+    std::vector<int64_t> regs = linker.getBits() == 64 ? registersAfter<VM64>(image) : registersAfter<VM>(image);
+    regs.pop_back();
+    return regs;
+}
+
+std::string describe(const std::vector<int64_t>& regs) {
+    std::string text;
+    for (size_t i = 0; i < regs.size(); i++) {
+        text += " R" + std::to_string(i) + "=" + std::to_string(regs[i]);
+    }
+    return text;
+}
+
+void check(bool condition, const std::string& message) {
+    if (!condition) {
+        throw std::runtime_error(message);
+    }
+}
+
+// Code from an included .bits 64 file is encoded in its own mode when streamed
+void streamedIncludeKeepsMode() {
+    writeSource("wide.inc", ".bits 64\nmov r1, 5000000000\n");
+    std::string path = writeSource("include64.asm", ".include \"wide.inc\"\nmov r2, r1\nret\n");
+    check(objectBytes(assembleStreamed(path)) == objectBytes(assembleBuffered(path, false)),
+        "streamed and buffered objects differ");
+}
+
+// The program built from the sources leaves the same registers with -O as
+// without
+void checkOptimizedRun(const std::vector<std::string>& paths) {
+    std::vector<ObjectFile> plain;
+    std::vector<ObjectFile> optimized;
+    for (const std::string& path : paths) {
+        plain.push_back(assembleBuffered(path, false));
+        optimized.push_back(assembleBuffered(path, true));
+    }
+    std::vector<int64_t> expected = run(plain);
+    std::vector<int64_t> actual = run(optimized);
+    check(expected == actual, "-O changed the result:\n  expected" + describe(expected) + "\n  actual  " + describe(actual));
+}
+
+// A MOV to R15 is a jump, so a later MOV to R15 does not overwrite it
+void programCounterMovesKept() {
+    checkOptimizedRun({ writeSource("pcmove.asm",
+        "main:\n"
+        "    mov r9, 11\n"
+        "    mov r15, done\n"
+        "    mov r15, other\n"
+        "done:\n"
+        "    ret\n"
+        "other:\n"
+        "    mov r9, 22\n"
+        "    ret\n") });
+}
+
+// Labels are global symbols. A loop only jumped to inside its own object is
+// still a routine another object can call.
+void calledLoopKept() {
+    checkOptimizedRun({
+        writeSource("loopdef.asm",
+            "done:\n"
+            "    ret\n"
+            "lp:\n"
+            "    add r2, r2, 10\n"
+            "    sub r1, r1, 1\n"
+            "    cmp r1, 0\n"
+            "    jg lp\n"
+            "    ret\n"),
+        writeSource("loopcall.asm",
+            "main:\n"
+            "    mov r1, 10\n"
+            "    mov r2, 0\n"
+            "    call lp\n"
+            "    ret\n") });
+}
+
+// Values reaching a label through local jumps are not all the values it
+// sees when another object calls it
+void calledLabelNotPropagated() {
+    checkOptimizedRun({
+        writeSource("incdef.asm",
+            "setup:\n"
+            "    mov r3, 5\n"
+            "    jmp inc\n"
+            "    mov r3, 7\n"
+            "inc:\n"
+            "    add r4, r3, 1\n"
+            "    ret\n"),
+        writeSource("inccall.asm",
+            "main:\n"
+            "    mov r3, 100\n"
+            "    call inc\n"
+            "    ret\n") });
+}
+
+// A loop header another object calls still runs the preheader the loop
+// rewrites rely on
+void calledLoopHeaderRunsPreheader() {
+    checkOptimizedRun({
+        writeSource("sumdef.asm",
+            "setup:\n"
+            "    ret\n"
+            "lp:\n"
+            "    add r5, r0, 1\n"
+            "    mul r4, r0, r3\n"
+            "    add r2, r2, r4\n"
+            "    add r2, r2, r5\n"
+            "    sub r3, r3, 1\n"
+            "    cmp r3, 0\n"
+            "    jg lp\n"
+            "    ret\n"),
+        writeSource("sumcall.asm",
+            "main:\n"
+            "    mov r0, 7\n"
+            "    mov r3, 4\n"
+            "    mov r2, 5\n"
+            "    call lp\n"
+            "    ret\n") });
+}
+
+// A space after the minus in a memory operand does not change its meaning
+void memoryOperandMinusSpacing() {
+    std::string tight = writeSource("minustight.asm", "main:\n    load r2, [r1-8]\n    store [r1+r3*4-16], r2\n    ret\n");
+    std::string spaced = writeSource("minusspaced.asm", "main:\n    load r2, [r1 - 8]\n    store [r1 + r3*4 - 16], r2\n    ret\n");
+    check(objectBytes(assembleBuffered(tight, false)) == objectBytes(assembleBuffered(spaced, false)),
+        "spaced and unspaced operands differ");
+}
+
+struct Test {
+    const char* name;
+    void (*run)();
+};
+
+const Test tests[] = {
+    { "streamed-include-keeps-mode", streamedIncludeKeepsMode },
+    { "program-counter-moves-kept", programCounterMovesKept },
+    { "called-loop-kept", calledLoopKept },
+    { "called-label-not-propagated", calledLabelNotPropagated },
+    { "called-loop-header-runs-preheader", calledLoopHeaderRunsPreheader },
+    { "memory-operand-minus-spacing", memoryOperandMinusSpacing },
+};
+
+} // namespace
+
+int main() {
+    int32_t failed = 0;
+    for (const Test& test : tests) {
+        try {
+            test.run();
+            std::cout << "PASS " << test.name << "\n";
+        }
+        catch (const std::exception& ex) {
+            std::cout << "FAIL " << test.name << ": " << ex.what() << "\n";
+            failed++;
+        }
+    }
+    std::cout << failed << " of " << std::size(tests) << " failed\n";
+    return failed ? 1 : 0;
+}